@@ -4,6 +4,8 @@
 #include "freertos/queue.h"
 #include <fft_analysis.h>
 #include <shared_defs.h>
+#include "spectral_change.h"
+#include "window_aggregate.h"
 
 // Configuration Constants
 #define TASK_STACK_SIZE      4096    // Bytes per task stack
@@ -39,6 +41,7 @@ void print_averages() {
  * @param pvParameters FreeRTOS task parameters (unused)
  * @details
  * - Generates signal samples at configured rate
+ * - Re-evaluates the rate when the spectral change detector fires
  * - Pushes samples to processing queue
  * - Self-terminates after acquiring NUM_OF_SAMPLES_AGGREGATE
  * 
@@ -46,24 +49,28 @@ void print_averages() {
  */
 void sampling_task(void *pvParameters) {
   float sample = 0.0f;
-  long last_fft_time = millis();
-  long current_time;
+  spectral_change_t spectrum_monitor;
+  spectral_change_init(&spectrum_monitor, g_sampling_frequency);
 
   Serial.printf("[SAMPLING] Starting sampling at %d Hz\n", g_sampling_frequency);
   Serial.println("--------------------------------");
 
   for (int i = 0; i < NUM_OF_SAMPLES_AGGREGATE; i++) {
       sample = sample_signal(curr_signal, i, g_sampling_frequency);
+      fft_streaming_update(sample);
       
       // Change signal at sample 20
       if (i == 20)
           curr_signal = signal_high_freq;
       
-      // Check if it's time to run FFT (every 3 seconds)
-      current_time = millis();
-      if (current_time - last_fft_time > 3000) {
-          fft_init();
-          last_fft_time = current_time;
+      // Re-evaluate the rate only when the spectrum has changed,
+      // a full FFT burst only runs if the streaming spectrum can't decide
+      if (spectral_change_update(&spectrum_monitor, sample)) {
+          if (!fft_streaming_adjust_sampling_rate()) {
+              fft_init();
+          }
+          spectral_change_set_rate(&spectrum_monitor, g_sampling_frequency);
+          spectral_change_reset(&spectrum_monitor);
       }
       
       xQueueSend(xQueueSamples, &sample, 0);
@@ -83,42 +90,28 @@ void sampling_task(void *pvParameters) {
  * @param pvParameters FreeRTOS task parameters (unused)
  * 
  * @implements
- * - Circular buffer for WINDOW_SIZE samples
- * - Moving average calculation
+ * - Sliding window of WINDOW_SIZE samples, O(1) AGGREGATE_WINDOW aggregate (window_aggregate.h)
  * - Results storage in averages[] array
  * 
  */
 void average_task(void *pvParameters) {
-  float sum = 0;
   float average = 0;
   float value;
-  
-  // Circular buffer implementation
-  float sampleReadings[WINDOW_SIZE] = {0};  // Storage for sliding window
+  AGGREGATE_WINDOW<float, WINDOW_SIZE> window;  // Sliding window
   int num_of_avgs = 0;   // Total processed samples counter
-  int pos = 0;              // Current position in circular buffer
-  int valid_samples = 0;    // Count of initialized buffer elements
 
 
   while (1) {
     if (xQueueReceive(xQueueSamples, &value, (TickType_t)portMAX_DELAY)) {
 
-      // Update circular buffer
-      sampleReadings[pos] = value;
-      pos = (pos + 1) % WINDOW_SIZE;
+      // Update the window and its moving aggregate
+      window.push(value);
+      average = window.value();
 
       Serial.printf("[AGGREGATE] Sample read: %.2f\n",value);
 
-      if (valid_samples < WINDOW_SIZE) valid_samples++; // Ensure we don't exceed the array size
-      // Calculate moving average
-      sum = 0;
-      for (int i = 0; i < valid_samples; i++) {
-          sum += sampleReadings[i];
-      }
-      average = sum / WINDOW_SIZE;
-
       // Store and log results
-      if(valid_samples == WINDOW_SIZE){
+      if(window.full()){
         averages[num_of_avgs] = average;
         Serial.printf("[AGGREGATE] Window %d: %.2f\n", num_of_avgs, average);
         num_of_avgs++;
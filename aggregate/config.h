@@ -1,5 +1,6 @@
 #pragma once
 #define WINDOW_SIZE 5
+#define AGGREGATE_WINDOW WindowMean // Moving aggregate: WindowMean, WindowMin, WindowMax, WindowVariance or Ewma
 
 #define WIFI_MAX_RETRIES 10
 #define MSG_BUFFER_SIZE 50
@@ -9,7 +10,25 @@
 #define SUBSCRIBE_TOPIC "luca/esp32/acks"
 
 #define INIT_SAMPLE_RATE 1000 // Hz
+#define NYQUIST_MULTIPLIER 2.5f // Sampling rate / max frequency
+#define RATE_MIN 1 // Hz
+#define RATE_MAX INIT_SAMPLE_RATE // Hz
+#define RATE_LOWER_RATIO 0.8f // Lower only if the required rate is below this fraction of the current one
+#define RATE_LOWER_HOLD 2 // Consecutive estimates needed to lower the rate
+#define RATE_MAX_STEP_UP 4 // Largest raise factor per decision
+#define RATE_MAX_STEP_DOWN 4 // Largest lowering factor per decision
+#define RATE_ALIAS_FRACTION 0.9f // Peaks above this fraction of Nyquist may be aliased
+#define RATE_CHANGE_TOLERANCE 0.1f // Relative estimate change treated as a new regime
 #define NUM_SAMPLES 1024
+#define FFT_WINDOW_TYPE FFT_WINDOW_HAMMING
+#define SDFT_WINDOW_SIZE 64 // Streaming spectrum length (power of two)
+#define SDFT_MIN_AMPLITUDE 0.5f // Peak amplitude floor of the streaming spectrum
+#define SPECTRAL_BLOCK_SIZE 32 // Samples per feature vector of the change detector
+#define SPECTRAL_BANDS 4 // Goertzel bands of the change detector, spread up to Nyquist
+#define SPECTRAL_LEARN_BLOCKS 16 // Blocks that set the reference spectrum after a reset
+#define SPECTRAL_MIN_SPREAD 0.02f // Floor of the learnt feature spread
+#define CUSUM_SLACK 1.0f // Tolerated feature shift, in learnt spreads per block
+#define CUSUM_THRESHOLD 8.0f // Accumulated shift that signals a change, in spreads
 #define QUEUE_SIZE NUM_OF_SAMPLES_AGGREGATE
 
 #define NUM_OF_SAMPLES_AGGREGATE 10
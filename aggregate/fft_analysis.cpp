@@ -1,30 +1,29 @@
 #include "fft_analysis.h"
 #include <Arduino.h>
-#include <arduinoFFT.h>
 #include <math.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "config.h"
 #include "shared_defs.h"
+#include "fft_plan.h"
+#include "sliding_dft.h"
 #define NOISE_THRESHOLD 8
 
 
-/// @brief Real component buffer for FFT input
+/// @brief Real sample buffer for FFT input, holds magnitudes after analysis
 float g_samples_real[NUM_SAMPLES] = {0};
 
-/// @brief Imaginary component buffer for FFT input
-float g_samples_imag[NUM_SAMPLES] = {0};
-
 /// @brief Current system sampling frequency (Hz)
 int g_sampling_frequency = INIT_SAMPLE_RATE;
 
-/// @brief ArduionFFT instance configured with buffers
-ArduinoFFT<float> FFT = ArduinoFFT<float>(
-    g_samples_real, 
-    g_samples_imag, 
-    NUM_SAMPLES, 
-    g_sampling_frequency
-);
+/// @brief FFT plan with compile-time window and twiddle tables
+typedef FftPlan<NUM_SAMPLES, FFT_WINDOW_TYPE> fft_plan_t;
+
+/// @brief Streaming spectrum of the normal sample stream
+static sliding_dft_t g_spectrum;
+
+/// @brief Decides rate changes from max frequency estimates, the first one calibrates it
+static rate_controller_t g_rate_controller;
 
 signal_function curr_signal = signal_low_freq;
 
@@ -71,9 +70,10 @@ float sample_signal(signal_function sig_func, int index, int sample_rate) {
  * @param num_samples Number of samples to acquire
  */
 void fft_process_signal(signal_function sig_func,int num_samples) {
+    // The burst interrupts the normal stream
+    sdft_reset(&g_spectrum);
     for( int i= 0; i< num_samples;i++){
       g_samples_real[i] = 0;
-      g_samples_imag[i] = 0;
     }
     for (int i = 0; i < num_samples; i++) {
       g_samples_real[i] = sample_signal(sig_func, i, g_sampling_frequency);
@@ -85,15 +85,16 @@ void fft_process_signal(signal_function sig_func,int num_samples) {
 /**
  * @brief Execute complete FFT processing chain
  * @details Performs:
- * 1. Hamming window application
- * 2. Forward FFT computation
+ * 1. Window application (FFT_WINDOW_TYPE)
+ * 2. Forward real-input FFT computation
  * 3. Complex-to-magnitude conversion
- * @note Results stored in module buffers
+ * @note Tables are precomputed in flash, only the butterflies run here
+ * @note Magnitudes of bins 0..NUM_SAMPLES/2 stored in g_samples_real
  */
 void fft_perform_analysis(void) {
-    FFT.windowing(FFT_WIN_TYP_HAMMING, FFT_FORWARD);
-    FFT.compute(FFT_FORWARD);
-    FFT.complexToMagnitude();
+    fft_plan_t::window(g_samples_real);
+    fft_plan_t::forward(g_samples_real);
+    fft_plan_t::magnitude(g_samples_real);
 }
 
 /**
@@ -122,11 +123,61 @@ float fft_get_max_frequency(void) {
 /**
  * @brief Adapt sampling rate based on Nyquist-Shannon criteria
  * @param max_freq Max detected frequency component
- * @note Implements safety factor of 2.5× maximum frequency
+ * @note Implements safety factor of NYQUIST_MULTIPLIER × maximum frequency,
+ * raising and lowering through the rate controller (rate_controller.h)
+ * @note Keeps the current rate if no component was found (max_freq <= 0)
  */
 void fft_adjust_sampling_rate(float max_freq) {
-    const int new_rate = (int)(NYQUIST_MULTIPLIER * max_freq);
-    g_sampling_frequency = (g_sampling_frequency > new_rate) ? new_rate : g_sampling_frequency;
+    const rate_decision_t decision = rate_controller_update(&g_rate_controller, g_sampling_frequency, max_freq);
+    g_sampling_frequency = decision.rate;
+
+    // Streaming bins are spaced by the sampling rate, start over on change
+    if (decision.action != RATE_HOLD) {
+        sdft_reset(&g_spectrum);
+    }
+}
+
+/**
+ * @brief Last decision taken by fft_adjust_sampling_rate()
+ */
+const rate_decision_t *fft_last_rate_decision(void) {
+    return rate_controller_last(&g_rate_controller);
+}
+
+/* Streaming Spectrum ------------------------------------------------------ */
+/**
+ * @brief Feed one sample of the normal stream to the streaming spectrum
+ * @param sample Sample taken at g_sampling_frequency
+ * @note O(SDFT_WINDOW_SIZE/2) per call
+ */
+void fft_streaming_update(float sample) {
+    sdft_update(&g_spectrum, sample);
+}
+
+/**
+ * @brief Max frequency seen by the streaming spectrum
+ * @return Frequency (Hz), -1 until SDFT_WINDOW_SIZE samples were fed at the
+ * current rate or if no peak clears SDFT_MIN_AMPLITUDE
+ * @note Only content below g_sampling_frequency/2 is visible, a peak close
+ * to it is handled by the rate controller alias guard
+ */
+float fft_streaming_max_frequency(void) {
+    return sdft_max_frequency(&g_spectrum, g_sampling_frequency);
+}
+
+/**
+ * @brief Adapt sampling rate from the streaming spectrum
+ * @return true if the rate was re-evaluated without an acquisition burst,
+ * false if the streaming spectrum has no estimate yet and the caller has to
+ * fall back to a full FFT acquisition
+ */
+bool fft_streaming_adjust_sampling_rate(void) {
+    const float max_freq = fft_streaming_max_frequency();
+    if (max_freq <= 0) {
+        return false;
+    }
+    fft_adjust_sampling_rate(max_freq);
+    return true;
 }
 
 /**
@@ -139,8 +190,8 @@ void fft_adjust_sampling_rate(float max_freq) {
  */
 void fft_init(void) {
     Serial.println("[FFT] Initializing FFT module");
-    
     g_sampling_frequency = INIT_SAMPLE_RATE;
+    rate_controller_init(&g_rate_controller);  // Full-band estimate, recalibrate
     
     // Initial analysis with default signal
     fft_process_signal(curr_signal,NUM_SAMPLES);
@@ -151,7 +202,7 @@ void fft_init(void) {
     Serial.printf("[FFT] Peak frequency: %.2f Hz\n", peak_freq);
 
     fft_adjust_sampling_rate(peak_freq);
-    Serial.printf("[FFT] Optimal sampling rate: %d Hz\n", g_sampling_frequency);
+    Serial.printf("[FFT] Optimal sampling rate: %d Hz (%s)\n", g_sampling_frequency, rate_reason_name(fft_last_rate_decision()->reason));
 }
 
 /**
@@ -174,6 +225,7 @@ void fft_sampling_task(void *pvParameters) {
         sample = sample_signal(curr_signal, i, g_sampling_frequency);
         
         xQueueSend(xQueueSamples, &sample, 0);
+        fft_streaming_update(sample);
 
         Serial.printf("[SAMPLING] Sample %d: %.2f\n", i, sample);
         vTaskDelay(pdMS_TO_TICKS(1000/g_sampling_frequency));
@@ -0,0 +1,60 @@
+#pragma once
+#include <stdint.h>
+#include "config.h"
+
+/*
+ * Adaptive sampling rate controller
+ * Turns max frequency estimates into sampling rate changes in both
+ * directions. Raises are applied at once, since undersampling loses data,
+ * lowering needs RATE_LOWER_HOLD consecutive estimates that clear the
+ * RATE_LOWER_RATIO hysteresis band. Every step is slew limited and lands on
+ * a rate whose period is a whole number of microseconds.
+ * Content above the current Nyquist frequency folds back onto lower bins and
+ * can't be told apart from a real change, so an estimate that moves by more
+ * than RATE_CHANGE_TOLERANCE sends the rate to RATE_MAX for one full-band
+ * estimate, which then recalibrates the controller.
+ */
+
+// What the controller did with an estimate
+typedef enum {
+    RATE_HOLD,
+    RATE_RAISE,
+    RATE_LOWER
+} rate_action_t;
+
+// Why it did it
+typedef enum {
+    RATE_REASON_NO_COMPONENT,  // No peak found, nothing to act on
+    RATE_REASON_IN_BAND,       // Current rate already fits the estimate
+    RATE_REASON_ALIAS_GUARD,   // Peak in the Nyquist safety band, may be aliased
+    RATE_REASON_REGIME_CHANGE, // Estimate moved, probe the full band
+    RATE_REASON_UNDERSAMPLED,  // Estimate needs a higher rate
+    RATE_REASON_HYSTERESIS,    // Lower rate possible, waiting for confirmation
+    RATE_REASON_OVERSAMPLED,   // Lower rate confirmed
+    RATE_REASON_CALIBRATION    // First estimate, applied without slew limit
+} rate_reason_t;
+
+// Outcome of one estimate
+typedef struct {
+    rate_action_t action;
+    rate_reason_t reason;
+    float max_freq;       // Estimate the decision was based on (Hz)
+    int previous_rate;    // Rate before the decision (Hz)
+    int required_rate;    // Quantised NYQUIST_MULTIPLIER * max_freq (Hz)
+    int rate;             // Rate to sample at from now on (Hz)
+} rate_decision_t;
+
+// Controller state
+typedef struct {
+    uint8_t lower_votes;     // Consecutive estimates asking for a lower rate
+    bool calibrated;         // An estimate has been applied since init
+    float reference_freq;    // Estimate of the previous decision (Hz)
+    rate_decision_t last;    // Most recent decision
+} rate_controller_t;
+
+// Public API
+void rate_controller_init(rate_controller_t *ctl);
+rate_decision_t rate_controller_update(rate_controller_t *ctl, int current_rate, float max_freq);
+const rate_decision_t *rate_controller_last(const rate_controller_t *ctl);
+int rate_quantize_up(float rate);
+const char *rate_reason_name(rate_reason_t reason);
@@ -0,0 +1,90 @@
+#include "sliding_dft.h"
+#include <math.h>
+#include <string.h>
+#include "fft_plan.h"
+
+// Pole radius < 1 keeps float rounding from accumulating in the recursion
+#define SDFT_DAMPING 0.9999f
+
+// cos/sin(-2*pi*k/SDFT_WINDOW_SIZE) for 0 <= k < SDFT_BINS, generated in flash
+typedef fft_detail::make_index_seq<SDFT_BINS>::type sdft_index_t;
+typedef fft_detail::ct_table<fft_detail::twiddle_re_gen<SDFT_WINDOW_SIZE>, sdft_index_t> sdft_cos_t;
+typedef fft_detail::ct_table<fft_detail::twiddle_im_gen<SDFT_WINDOW_SIZE>, sdft_index_t> sdft_sin_t;
+
+/// @brief base^n by squaring, evaluated at compile time
+static constexpr float ct_powf(float base, uint16_t n) {
+    return n == 0 ? 1.0f : ((n & 1) ? base * ct_powf(base * base, n >> 1) : ct_powf(base * base, n >> 1));
+}
+
+/// @brief Weight of the sample leaving the window, SDFT_DAMPING^SDFT_WINDOW_SIZE
+static constexpr float DAMPING_TAIL = ct_powf(SDFT_DAMPING, SDFT_WINDOW_SIZE);
+
+/**
+ * @brief Clear the spectrum and sample history
+ * @param sdft Spectrum state
+ */
+void sdft_reset(sliding_dft_t *sdft) {
+    memset(sdft, 0, sizeof(*sdft));
+}
+
+/**
+ * @brief Slide the window by one sample
+ * @param sdft Spectrum state
+ * @param sample Newest sample
+ * @details X_k = e^{+j2pik/L} * (r * X_k + x[n] - r^L * x[n-L]), O(SDFT_BINS)
+ */
+void sdft_update(sliding_dft_t *sdft, float sample) {
+    const float oldest = sdft->history[sdft->pos];
+    sdft->history[sdft->pos] = sample;
+    sdft->pos = (sdft->pos + 1) % SDFT_WINDOW_SIZE;
+    sdft->count++;
+
+    const float delta = sample - DAMPING_TAIL * oldest;
+    for (uint16_t k = 0; k < SDFT_BINS; k++) {
+        const float a_re = SDFT_DAMPING * sdft->re[k] + delta;
+        const float a_im = SDFT_DAMPING * sdft->im[k];
+        // Rotation by e^{+j2pik/L} is the conjugate of the forward twiddle
+        const float w_re = sdft_cos_t::values[k];
+        const float w_im = -sdft_sin_t::values[k];
+        sdft->re[k] = a_re * w_re - a_im * w_im;
+        sdft->im[k] = a_re * w_im + a_im * w_re;
+    }
+}
+
+/**
+ * @brief Check if a full window has been observed since the last reset
+ * @param sdft Spectrum state
+ */
+bool sdft_ready(const sliding_dft_t *sdft) {
+    return sdft->count >= SDFT_WINDOW_SIZE;
+}
+
+/**
+ * @brief Identify max frequency component of the current window
+ * @param sdft Spectrum state
+ * @param sampling_frequency Rate the stream is sampled at (Hz)
+ * @return Frequency (Hz) of the highest peak, -1 if not ready or no peak
+ * @details Bins are Hann-windowed in the frequency domain
+ * (0.5*X[k] - 0.25*(X[k-1] + X[k+1])) and scaled to sine amplitude (4/L)
+ * before being compared against SDFT_MIN_AMPLITUDE.
+ */
+float sdft_max_frequency(const sliding_dft_t *sdft, int sampling_frequency) {
+    if (!sdft_ready(sdft)) {
+        return -1;
+    }
+
+    float amplitude[SDFT_BINS] = {0};
+    for (uint16_t k = 1; k < SDFT_BINS - 1; k++) {
+        const float re = 0.5f * sdft->re[k] - 0.25f * (sdft->re[k - 1] + sdft->re[k + 1]);
+        const float im = 0.5f * sdft->im[k] - 0.25f * (sdft->im[k - 1] + sdft->im[k + 1]);
+        amplitude[k] = 4.0f * sqrtf(re * re + im * im) / SDFT_WINDOW_SIZE;
+    }
+
+    // Highest local maximum above the amplitude floor (skip DC)
+    for (uint16_t k = SDFT_BINS - 2; k >= 1; k--) {
+        if (amplitude[k] > amplitude[k - 1] && amplitude[k] >= amplitude[k + 1] && amplitude[k] > SDFT_MIN_AMPLITUDE) {
+            return (float)k * sampling_frequency / SDFT_WINDOW_SIZE;
+        }
+    }
+    return -1;
+}
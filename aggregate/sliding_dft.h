@@ -0,0 +1,28 @@
+#pragma once
+#include <stdint.h>
+#include "config.h"
+
+/*
+ * Sliding DFT spectrum
+ * Keeps the lower half of an SDFT_WINDOW_SIZE-point DFT up to date with one
+ * complex rotation per bin for every new sample, so the max frequency of the
+ * stream can be read at any time without an oversampling burst.
+ * SDFT_WINDOW_SIZE must be a power of two.
+ */
+
+#define SDFT_BINS (SDFT_WINDOW_SIZE / 2)
+
+// Streaming spectrum state
+typedef struct {
+    float history[SDFT_WINDOW_SIZE];  // Last SDFT_WINDOW_SIZE samples
+    float re[SDFT_BINS];              // Real part of bins 0..SDFT_BINS-1
+    float im[SDFT_BINS];              // Imaginary part of bins 0..SDFT_BINS-1
+    uint16_t pos;                     // Oldest sample in history
+    uint32_t count;                   // Samples seen since last reset
+} sliding_dft_t;
+
+// Public API
+void sdft_reset(sliding_dft_t *sdft);
+void sdft_update(sliding_dft_t *sdft, float sample);
+bool sdft_ready(const sliding_dft_t *sdft);
+float sdft_max_frequency(const sliding_dft_t *sdft, int sampling_frequency);
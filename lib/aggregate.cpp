@@ -1,17 +1,71 @@
+#include <atomic>
 #include "fft_analysis.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "shared_defs.h"
 #include "config.h"
+#include "time_window.h"
+#include "aggregate_record.h"
+#include "sample_scheduler.h"
+#include "rollup.h"
+#include "quantile_sketch.h"
 
 
-// Global averages storage
-float avgs[SIZE_AVG_ARRAY] = {0};
+/// @brief 1 s / 10 s / 1 min rollups of the stream, written by the averaging task
+static rollup_t s_rollup;
 
+/// @brief Percentiles of the open and of the last closed finest rollup bucket
+static quantile_sketch_t s_sketches[2];
+
+/// @brief Sketch of the open bucket, owned by the averaging task
+static uint8_t s_sketch_open = 0;
+
+/// @brief Sketch of the last closed bucket, swapped with the open one when a bucket closes
+static uint8_t s_sketch_last = 1;
+
+/// @brief Guards s_rollup and s_sketch_last between the averaging task and queries from other tasks, a mutex as the copies are too long to mask interrupts
+static std::atomic<SemaphoreHandle_t> s_rollup_lock(NULL);
+
+
+/**
+ * @brief Last closed buckets of a rollup level, safe to call from any task
+ * @param level 0 for the finest resolution (ROLLUP_PERIODS_MS)
+ * @param out Receives the buckets, oldest first
+ * @param n Buckets wanted, at most ROLLUP_CAPACITY are kept
+ * @return Buckets copied, 0 before the averaging task started
+ */
+uint16_t aggregate_rollup_last(uint8_t level, aggregate_record_t *out, uint16_t n) {
+  const SemaphoreHandle_t lock = s_rollup_lock.load(std::memory_order_acquire);
+  if (lock == NULL) {
+    return 0;
+  }
+  xSemaphoreTake(lock, portMAX_DELAY);
+  n = rollup_last(&s_rollup, level, out, n);
+  xSemaphoreGive(lock);
+  return n;
+}
+
+/**
+ * @brief Quantile sketch of the last closed bucket of the finest rollup level
+ * @param out Receives the sketch, to query, merge or serialize
+ * @return false before the first bucket closed
+ */
+bool aggregate_sketch_last(quantile_sketch_t *out) {
+  const SemaphoreHandle_t lock = s_rollup_lock.load(std::memory_order_acquire);
+  if (lock == NULL) {
+    out->count = 0;
+    return false;
+  }
+  xSemaphoreTake(lock, portMAX_DELAY);
+  *out = s_sketches[s_sketch_last];
+  xSemaphoreGive(lock);
+  return out->count > 0;
+}
 
 /**
- * @brief Prints formatted averages list to serial output
+ * @brief Prints the averages of the finest rollup level to serial output
  * @details Output format:
  * --- Averages List ---
  * Average [1]: 12.34
@@ -19,13 +73,15 @@ float avgs[SIZE_AVG_ARRAY] = {0};
  * ---------------------
  */
 void printAverages() {
+  static aggregate_record_t buckets[ROLLUP_CAPACITY];
+  const uint16_t n = aggregate_rollup_last(0, buckets, ROLLUP_CAPACITY);
   Serial.println("\n--- Averages List ---");
   
-  for (int i = 0; i < SIZE_AVG_ARRAY; i++) {
+  for (int i = 0; i < n; i++) {
     Serial.print("Average [");
     Serial.print(i + 1);
     Serial.print("]: ");
-    Serial.println(avgs[i], 2); 
+    Serial.println(buckets[i].mean, 2); 
   }
   
   Serial.println("---------------------");
@@ -36,48 +92,90 @@ void printAverages() {
  * @param pvParameters FreeRTOS task parameters (unused)
  * 
  * @implements
- * - Circular buffer for WINDOW_SIZE samples
- * - Moving average calculation
- * - Results storage in avgs[] array
+ * - Block-wise reception of the sample stream (sample_blocks.h)
+ * - TIME_WINDOW_KIND windows of TIME_WINDOW_SIZE_MS on the sample timestamps (time_window.h)
+ * - One aggregate record per window and a single pass per pane run (aggregate_record.h)
+ * - Records to the transmission task and into the rollups (rollup.h)
+ * - A quantile sketch of every finest rollup bucket (quantile_sketch.h)
  * 
  */
 void average_task_handler(void *pvParameters) {
-  float sum = 0;
-  float average = 0;
-  float value;
-  
-  // Circular buffer implementation
-  float sampleReadings[WINDOW_SIZE] = {0};  // Storage for sliding window
+  time_window_t window;
+  time_window_result_t result;
+  aggregate_record_t run;
   int num_of_samples = 0;   // Total processed samples counter
-  int pos = 0;              // Current position in circular buffer
-  int valid_samples = 0;    // Count of initialized buffer elements
+
+  time_window_init(&window, TIME_WINDOW_KIND, TIME_WINDOW_SIZE_MS, TIME_WINDOW_HOP_MS);
+  rollup_init(&s_rollup);
+  quantile_sketch_init(&s_sketches[0]);
+  quantile_sketch_init(&s_sketches[1]);
+  const SemaphoreHandle_t lock = xSemaphoreCreateMutex();
+  if (lock == NULL) {
+    Serial.printf("[AGGREGATE] Could not create the rollup mutex, stopping\n");
+    vTaskDelete(NULL);
+  }
+  s_rollup_lock.store(lock, std::memory_order_release);  // Queries see the stores above
 
   while (1) {
-    if (xQueueReceive(xQueueSamples, &(value), (TickType_t)portMAX_DELAY)) {
-      // Update circular buffer
-      sampleReadings[pos] = value;
-      pos = (pos + 1) % WINDOW_SIZE;
-
-      Serial.printf("[AGGREGATE] Sample read: %.2f\n",value);
-
-      if (valid_samples < WINDOW_SIZE) valid_samples++; // Ensure we don't exceed the array size
-      // Calculate moving average
-      sum = 0;
-      for (int i = 0; i < valid_samples; i++) {
-          sum += sampleReadings[i];
-      }
-      average = sum / WINDOW_SIZE;
+    sample_block_t *block = sample_block_receive(portMAX_DELAY);
+    if (block == NULL) {
+      continue;
+    }
+    const uint32_t period_us = sample_period_us(block->sampling_frequency);
+    uint16_t n = 0;
+    while (n < block->count) {
+      const uint32_t time_us = block->first_time_us + n * period_us;
 
-      // Store and log results
-      if(valid_samples == WINDOW_SIZE){
-        avgs[num_of_samples] = average;
-        Serial.printf("[AGGREGATE] Window %d: %.2f\n", num_of_samples, average);
+      // Store and log the windows that ended before this sample
+      while (time_window_advance(&window, time_us, &result)) {
+        const aggregate_record_t *record = &result.record;
+        Serial.printf("[AGGREGATE] Window %d: %lu samples in %lu ms, mean %.2f, min %.2f, max %.2f, var %.3f\n",
+                      num_of_samples, (unsigned long)record->count,
+                      (unsigned long)((result.end_us - result.start_us) / 1000),
+                      record->mean, record->min, record->max, record->variance);
         
-        xQueueSend(xQueueAvgs, &average, (TickType_t)0);
+        g_avg_ring.push(*record);
 
         num_of_samples++;
       }
 
+      xSemaphoreTake(lock, portMAX_DELAY);
+      const bool bucket_closed = rollup_advance(&s_rollup, time_us);
+      xSemaphoreGive(lock);
+
+      // Publish the percentiles of the bucket that just closed, by swapping buffers instead of copying
+      if (bucket_closed) {
+        quantile_sketch_t *closed = &s_sketches[s_sketch_open];
+        Serial.printf("[AGGREGATE] Bucket p50 %.2f, p90 %.2f, p99 %.2f\n",
+                      quantile_sketch_quantile(closed, 0.5f), quantile_sketch_quantile(closed, 0.9f),
+                      quantile_sketch_quantile(closed, 0.99f));
+        xSemaphoreTake(lock, portMAX_DELAY);
+        s_sketch_last = s_sketch_open;
+        xSemaphoreGive(lock);
+        s_sketch_open ^= 1;
+        quantile_sketch_init(&s_sketches[s_sketch_open]);
+      }
+
+      // The samples up to the end of the current pane and rollup bucket in a single pass
+      uint16_t count = time_window_room(&window, time_us, period_us);
+      const uint16_t bucket_room = rollup_room(&s_rollup, time_us, period_us);
+      if (count > bucket_room) {
+        count = bucket_room;
+      }
+      if (count > block->count - n) {
+        count = block->count - n;
+      }
+      aggregate_record_reset(&run);
+      aggregate_record_add_samples(&run, &block->samples[n], count, time_us, period_us);
+      time_window_add_record(&window, &run);
+      quantile_sketch_add_samples(&s_sketches[s_sketch_open], &block->samples[n], count);
+      xSemaphoreTake(lock, portMAX_DELAY);
+      rollup_add(&s_rollup, &run);
+      xSemaphoreGive(lock);
+      n += count;
+
+      Serial.printf("[AGGREGATE] Samples read: %u, mean %.2f\n", count, run.mean);
+
       // if(num_of_samples >= SIZE_AVG_ARRAY){
       //   Serial.print("*************\n");
       //   Serial.print("Average task finished\n");
@@ -86,6 +184,7 @@ void average_task_handler(void *pvParameters) {
       //   break;
       // }
     }
+    sample_block_release(block);
   }
   vTaskDelete(NULL);
 }
\ No newline at end of file
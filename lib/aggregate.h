@@ -2,10 +2,11 @@
 #include <Arduino.h>
 #include "shared_defs.h"
 #include "config.h"
-
-// Global averages array
-extern float avgs[NUM_OF_SAMPLES_AGGREGATE];
+#include "aggregate_record.h"
+#include "quantile_sketch.h"
 
 // Function declarations
 void printAverages();
+uint16_t aggregate_rollup_last(uint8_t level, aggregate_record_t *out, uint16_t n);
+bool aggregate_sketch_last(quantile_sketch_t *out);
 void average_task_handler(void *args);
\ No newline at end of file
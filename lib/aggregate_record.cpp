@@ -0,0 +1,106 @@
+#include "aggregate_record.h"
+#include <string.h>
+
+/**
+ * @brief Empty the record
+ * @param r Record
+ */
+void aggregate_record_reset(aggregate_record_t *r) {
+    memset(r, 0, sizeof(*r));
+}
+
+/**
+ * @brief Add one sample (Welford)
+ * @param r Record
+ * @param value Sample
+ * @param time_us Time the sample was taken, after the previous one
+ */
+void aggregate_record_add(aggregate_record_t *r, float value, uint32_t time_us) {
+    if (r->count == 0) {
+        r->count = 1;
+        r->mean = value;
+        r->min = value;
+        r->max = value;
+        r->variance = 0.0f;
+        r->first_us = time_us;
+        r->last_us = time_us;
+        return;
+    }
+    r->count++;
+    const float delta = value - r->mean;
+    r->mean += delta / r->count;
+    const float m2 = r->variance * (r->count - 1) + delta * (value - r->mean);
+    r->variance = m2 / r->count;
+    r->min = fminf(r->min, value);
+    r->max = fmaxf(r->max, value);
+    r->last_us = time_us;
+}
+
+/**
+ * @brief Add a run of evenly spaced samples in a single pass
+ * @param r Record
+ * @param samples Samples in time order
+ * @param count Number of samples
+ * @param first_us Time of samples[0]
+ * @param period_us Time between samples
+ * @details The loop keeps four independent branch-free accumulators: sums of
+ * the samples and of their squares, both relative to samples[0] so the
+ * squares do not cancel, and the running min and max. The run is then merged
+ * into r like any other record.
+ */
+void aggregate_record_add_samples(aggregate_record_t *r, const fft_sample_t *samples, uint16_t count,
+                                  uint32_t first_us, uint32_t period_us) {
+    if (count == 0) {
+        return;
+    }
+    const float shift = sample_to_float(samples[0]);
+    float sum = 0.0f;
+    float sum_sq = 0.0f;
+    float lo = shift;
+    float hi = shift;
+    for (uint16_t i = 0; i < count; i++) {
+        const float value = sample_to_float(samples[i]);
+        const float x = value - shift;
+        sum += x;
+        sum_sq += x * x;
+        lo = fminf(lo, value);
+        hi = fmaxf(hi, value);
+    }
+
+    aggregate_record_t run;
+    const float mean = sum / count;
+    run.count = count;
+    run.mean = shift + mean;
+    run.min = lo;
+    run.max = hi;
+    run.variance = fmaxf(0.0f, sum_sq / count - mean * mean);
+    run.first_us = first_us;
+    run.last_us = first_us + (count - 1) * period_us;
+    aggregate_record_merge(r, &run);
+}
+
+/**
+ * @brief Append the record of the run that follows
+ * @param r Record, receives the merge
+ * @param next Record of later samples
+ */
+void aggregate_record_merge(aggregate_record_t *r, const aggregate_record_t *next) {
+    if (next->count == 0) {
+        return;
+    }
+    if (r->count == 0) {
+        *r = *next;
+        return;
+    }
+    const uint32_t count = r->count + next->count;
+    const float delta = next->mean - r->mean;
+    const float weight = (float)next->count / count;
+    const float m2 = r->variance * r->count + next->variance * next->count +
+                     delta * delta * r->count * weight;
+    r->mean += delta * weight;
+    r->variance = m2 / count;
+    r->min = fminf(r->min, next->min);
+    r->max = fmaxf(r->max, next->max);
+    r->last_us = next->last_us;
+    r->count = count;
+}
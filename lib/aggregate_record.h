@@ -0,0 +1,29 @@
+#pragma once
+#include <stdint.h>
+#include "fixed_point.h"
+
+/*
+ * Aggregate record
+ * Count, mean, min, max and variance of a run of samples together with the
+ * time of its first and last sample, the unit that travels from the
+ * aggregation task to the transmission layer. A block of samples is reduced
+ * in one branch-free pass, and records of adjacent runs merge exactly
+ * (Chan et al.), so windows are built from the records of their panes.
+ */
+
+typedef struct {
+    uint32_t count;
+    float mean;
+    float min;
+    float max;
+    float variance;      // Population variance
+    uint32_t first_us;   // Time of the first sample
+    uint32_t last_us;    // Time of the last sample
+} aggregate_record_t;
+
+// Public API
+void aggregate_record_reset(aggregate_record_t *r);
+void aggregate_record_add(aggregate_record_t *r, float value, uint32_t time_us);
+void aggregate_record_add_samples(aggregate_record_t *r, const fft_sample_t *samples, uint16_t count,
+                                  uint32_t first_us, uint32_t period_us);
+void aggregate_record_merge(aggregate_record_t *r, const aggregate_record_t *next);
@@ -0,0 +1,216 @@
+#include "block_pipeline.h"
+#include <atomic>
+#ifdef ARDUINO
+#include <Arduino.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+/// @brief The two acquisition blocks, supplied by block_pipeline_start()
+static fft_sample_t *s_blocks[2];
+static int s_block_rate[2];                   // Rate each block was acquired at
+static uint32_t s_block_ready_us[2];          // Time each block was handed over
+static std::atomic<bool> s_block_busy[2];     // Block owned by the worker
+static uint8_t s_fill_block = 0;              // Block the sampler writes to
+static uint16_t s_fill_pos = 0;               // Next sample index in it
+static uint32_t s_last_push_us = 0;
+static block_pipeline_analyse_fn s_analyse = NULL;
+static bool s_running = false;
+
+/// @brief Counters, each written by one side and read from any task
+static std::atomic<uint32_t> s_blocks_analysed;
+static std::atomic<uint32_t> s_blocks_dropped;
+static std::atomic<uint32_t> s_blocks_restarted;
+static std::atomic<uint32_t> s_max_sample_gap_us;
+static std::atomic<uint32_t> s_last_latency_us;
+static std::atomic<uint32_t> s_max_latency_us;
+
+/* Worker Seam -------------------------------------------------------------- */
+#ifdef ARDUINO
+static TaskHandle_t s_worker = NULL;
+
+static uint32_t pipeline_now_us(void) {
+    return micros();
+}
+
+static bool pipeline_worker_start(void (*worker)(void *)) {
+    return xTaskCreatePinnedToCore(worker, "FFT Analysis", FFT_ANALYSIS_STACK_SIZE, NULL, 1, &s_worker,
+                                   FFT_ANALYSIS_CORE) == pdPASS;
+}
+
+// Hands a block index to the worker, it is idle whenever a block is posted
+static void pipeline_worker_post(uint32_t block) {
+    xTaskNotify(s_worker, block, eSetValueWithOverwrite);
+}
+
+static uint32_t pipeline_worker_wait(void) {
+    uint32_t block;
+    while (xTaskNotifyWait(0, 0, &block, portMAX_DELAY) != pdTRUE) {
+    }
+    return block;
+}
+#else
+static pthread_t s_worker;
+static pthread_mutex_t s_worker_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_worker_cond = PTHREAD_COND_INITIALIZER;
+static bool s_worker_pending = false;
+static uint32_t s_worker_block;
+static void (*s_worker_fn)(void *) = NULL;
+
+static uint32_t pipeline_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000ull + ts.tv_nsec / 1000);
+}
+
+static void *pipeline_worker_entry(void *arg) {
+    s_worker_fn(arg);
+    return NULL;
+}
+
+static bool pipeline_worker_start(void (*worker)(void *)) {
+    s_worker_fn = worker;
+    return pthread_create(&s_worker, NULL, pipeline_worker_entry, NULL) == 0;
+}
+
+static void pipeline_worker_post(uint32_t block) {
+    pthread_mutex_lock(&s_worker_mutex);
+    s_worker_block = block;
+    s_worker_pending = true;
+    pthread_cond_signal(&s_worker_cond);
+    pthread_mutex_unlock(&s_worker_mutex);
+}
+
+static uint32_t pipeline_worker_wait(void) {
+    pthread_mutex_lock(&s_worker_mutex);
+    while (!s_worker_pending) {
+        pthread_cond_wait(&s_worker_cond, &s_worker_mutex);
+    }
+    s_worker_pending = false;
+    const uint32_t block = s_worker_block;
+    pthread_mutex_unlock(&s_worker_mutex);
+    return block;
+}
+#endif
+
+/* Pipeline ----------------------------------------------------------------- */
+/**
+ * @brief Raise a maximum counter, only its writer calls this
+ */
+static void pipeline_raise(std::atomic<uint32_t> *counter, uint32_t value) {
+    if (value > counter->load(std::memory_order_relaxed)) {
+        counter->store(value, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Worker, pinned to FFT_ANALYSIS_CORE on the device
+ * @param arg Unused
+ * @details Waits for a full block from block_pipeline_push(), hands it to the
+ * analyse callback, then releases it
+ */
+static void block_pipeline_worker(void *arg) {
+    while (1) {
+        const uint32_t block = pipeline_worker_wait();
+        s_analyse(s_blocks[block], s_block_rate[block]);
+
+        const uint32_t latency = pipeline_now_us() - s_block_ready_us[block];
+        s_last_latency_us.store(latency, std::memory_order_relaxed);
+        pipeline_raise(&s_max_latency_us, latency);
+        s_blocks_analysed.fetch_add(1, std::memory_order_relaxed);
+        s_block_busy[block].store(false, std::memory_order_release);
+    }
+}
+
+/**
+ * @brief Start the worker
+ * @param ping First block of NUM_SAMPLES samples
+ * @param pong Second block of NUM_SAMPLES samples
+ * @param analyse Called on the worker for every full block
+ * @return false if the pipeline already runs or the worker could not start
+ * @note Call before the sampling task starts pushing
+ */
+bool block_pipeline_start(fft_sample_t *ping, fft_sample_t *pong, block_pipeline_analyse_fn analyse) {
+    if (s_running) {
+        return false;
+    }
+    s_blocks[0] = ping;
+    s_blocks[1] = pong;
+    s_analyse = analyse;
+    s_fill_block = 0;
+    s_fill_pos = 0;
+    s_last_push_us = 0;
+    for (uint8_t b = 0; b < 2; b++) {
+        s_block_busy[b].store(false, std::memory_order_relaxed);
+    }
+    s_blocks_analysed.store(0, std::memory_order_relaxed);
+    s_blocks_dropped.store(0, std::memory_order_relaxed);
+    s_blocks_restarted.store(0, std::memory_order_relaxed);
+    s_max_sample_gap_us.store(0, std::memory_order_relaxed);
+    s_last_latency_us.store(0, std::memory_order_relaxed);
+    s_max_latency_us.store(0, std::memory_order_relaxed);
+    s_running = pipeline_worker_start(block_pipeline_worker);
+    return s_running;
+}
+
+/**
+ * @brief Append a sample of the normal stream to the acquisition block
+ * @param sample Sample value
+ * @param sampling_frequency Rate the sample was taken at (Hz)
+ * @details A full block is handed to the worker and filling continues in the
+ * other one. If the worker still owns the other block the full block is
+ * dropped and refilled, the sampler never waits.
+ */
+void block_pipeline_push(fft_sample_t sample, int sampling_frequency) {
+    if (!s_running) {
+        return;
+    }
+
+    const uint32_t now = pipeline_now_us();
+    if (s_last_push_us != 0) {
+        pipeline_raise(&s_max_sample_gap_us, now - s_last_push_us);
+    }
+    s_last_push_us = now;
+
+    // Bins are spaced by the rate, a block must not mix rates
+    if (s_fill_pos != 0 && s_block_rate[s_fill_block] != sampling_frequency) {
+        s_blocks_restarted.fetch_add(1, std::memory_order_relaxed);
+        s_fill_pos = 0;
+    }
+    if (s_fill_pos == 0) {
+        s_block_rate[s_fill_block] = sampling_frequency;
+    }
+    s_blocks[s_fill_block][s_fill_pos++] = sample;
+    if (s_fill_pos < NUM_SAMPLES) {
+        return;
+    }
+
+    s_fill_pos = 0;
+    const uint8_t next = s_fill_block ^ 1;
+    if (s_block_busy[next].load(std::memory_order_acquire)) {
+        s_blocks_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    s_block_busy[s_fill_block].store(true, std::memory_order_relaxed);
+    s_block_ready_us[s_fill_block] = now;
+    pipeline_worker_post(s_fill_block);
+    s_fill_block = next;
+}
+
+/**
+ * @brief Snapshot of the acquisition statistics, safe from any task
+ * @note Each counter is read atomically, the set may straddle one block
+ */
+block_pipeline_stats_t block_pipeline_get_stats(void) {
+    block_pipeline_stats_t stats;
+    stats.blocks_analysed = s_blocks_analysed.load(std::memory_order_relaxed);
+    stats.blocks_dropped = s_blocks_dropped.load(std::memory_order_relaxed);
+    stats.blocks_restarted = s_blocks_restarted.load(std::memory_order_relaxed);
+    stats.max_sample_gap_us = s_max_sample_gap_us.load(std::memory_order_relaxed);
+    stats.last_latency_us = s_last_latency_us.load(std::memory_order_relaxed);
+    stats.max_latency_us = s_max_latency_us.load(std::memory_order_relaxed);
+    return stats;
+}
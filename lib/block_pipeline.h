@@ -0,0 +1,32 @@
+#pragma once
+#include <stdint.h>
+#include "config.h"
+#include "fixed_point.h"
+
+/*
+ * Ping-pong block pipeline
+ * The sampler appends every sample to one of two NUM_SAMPLES blocks. A full
+ * block is handed to a worker on FFT_ANALYSIS_CORE and filling carries on in
+ * the other one, so the sampler never waits for a transform. If the worker
+ * still owns the other block the full one is dropped and refilled. The worker
+ * is a FreeRTOS task on the device and a pthread on a host (no ARDUINO), so
+ * the same code can be timed on Linux (utils/pipeline_host.cpp).
+ */
+
+// Ping-pong acquisition statistics
+typedef struct {
+    uint32_t blocks_analysed;    // Blocks transformed by the analysis task
+    uint32_t blocks_dropped;     // Blocks overwritten while the analysis was busy
+    uint32_t blocks_restarted;   // Blocks discarded because the rate changed
+    uint32_t max_sample_gap_us;  // Longest interval between two pushed samples
+    uint32_t last_latency_us;    // Block full -> rate decision, last block
+    uint32_t max_latency_us;     // Block full -> rate decision, worst block
+} block_pipeline_stats_t;
+
+// Runs on the worker for every full block, which it may overwrite
+typedef void (*block_pipeline_analyse_fn)(fft_sample_t *data, int sampling_frequency);
+
+// Public API
+bool block_pipeline_start(fft_sample_t *ping, fft_sample_t *pong, block_pipeline_analyse_fn analyse);
+void block_pipeline_push(fft_sample_t sample, int sampling_frequency);
+block_pipeline_stats_t block_pipeline_get_stats(void);
@@ -7,7 +7,8 @@
 #include "shared_defs.h"
 #include "secrets.h"
 #include "fft_analysis.h"
-#include <ArduinoJson.h>
+#include "payload.h"
+#include "spsc_ring.h"
 #include "config.h"
 #include "driver/uart.h"
 #include "esp_sleep.h"
@@ -16,9 +17,9 @@
 #include <esp_pm.h>
 #include <esp_wifi.h>
 #include <esp_wifi_types.h>
+#include <atomic>
 // Network Configuration
-#define MSG_BUFFER_SIZE 50  // Maximum size for MQTT messages
-#define SIZE_AVG_ARRAY NUM_OF_SAMPLES_AGGREGATE-WINDOW_SIZE+1
+#define SIZE_AVG_ARRAY (NUM_OF_SAMPLES_AGGREGATE-WINDOW_SIZE+1)
 
 /* Global Variables --------------------------------------------------------- */
 float start_time = 0.0;      // Timestamp when communication starts (ms)
@@ -27,9 +28,29 @@ float finish_time = 0.0;     // Timestamp when communication ends (ms)
 WiFiClient espClient;        // WiFi client instance
 PubSubClient client(espClient);  // MQTT client instance
 
-char msg[MSG_BUFFER_SIZE];   // Buffer for MQTT messages
+static_assert(MSG_BUFFER_SIZE >= PAYLOAD_BYTES(MQTT_BATCH_RECORDS), "MSG_BUFFER_SIZE must hold a batch");
+static_assert(MQTT_BATCH_RECORDS >= 1 && MQTT_BATCH_RECORDS <= 255, "MQTT_BATCH_RECORDS out of range");
 
-// Round-Trip Time (RTT) measurement storage
+// One encoded MQTT message
+typedef struct {
+  uint16_t len;
+  uint8_t data[MSG_BUFFER_SIZE];
+} outbound_frame_t;
+
+/// @brief Frames from the batching task to the network task, never waited on by the producer
+static SpscRing<outbound_frame_t, MQTT_OUTBOUND_QUEUE> s_outbound;
+
+/// @brief Pipeline counters, written by the network task and read from any task
+static std::atomic<uint32_t> s_published;
+static std::atomic<uint32_t> s_retried;
+static std::atomic<uint32_t> s_dropped;
+static std::atomic<uint32_t> s_connects;
+static std::atomic<uint32_t> s_connect_failures;
+
+uint32_t bytes_sent = 0;     // Payload bytes published
+uint32_t bytes_received = 0; // Payload bytes of the acks
+
+// Round-Trip Time (RTT) of the last SIZE_AVG_ARRAY records, indexed by id % SIZE_AVG_ARRAY
 struct rtt_data rtt_data_array[SIZE_AVG_ARRAY];
 
 /* Timing Functions --------------------------------------------------------- */
@@ -53,7 +74,7 @@ void end_time_comunication(){
 void print_volume_of_communication(){
     float duration_ms = finish_time - start_time;
     float duration_sec = duration_ms / 1000;
-    float total_bytes = 2*SIZE_AVG_ARRAY * sizeof(char)* MSG_BUFFER_SIZE;
+    float total_bytes = bytes_sent + bytes_received;
 
     float throughput_bps = total_bytes / duration_sec;
 
@@ -64,8 +85,9 @@ void print_volume_of_communication(){
     Serial.printf("  Duration (ms): %.2f\n", duration_ms);
     Serial.println("-----------------------------");
     Serial.println("Data Volume:");
-    Serial.printf("  Bytes Sent: %.2f\n", total_bytes/2);
-    Serial.printf("  Bytes Received: %.2f\n", total_bytes/2);
+    Serial.printf("  Messages Sent: %lu\n", (unsigned long)s_published.load());
+    Serial.printf("  Bytes Sent: %lu\n", (unsigned long)bytes_sent);
+    Serial.printf("  Bytes Received: %lu\n", (unsigned long)bytes_received);
     Serial.printf("  Total Volume: %.2f bytes\n", total_bytes);
     Serial.println("-----------------------------");
     Serial.println("Throughput:");
@@ -141,8 +163,44 @@ void wifi_init(){
 
 /* MQTT Functions ----------------------------------------------------------- */
 /**
- * @brief Establishes and maintains MQTT connection
+ * @brief Delay before the next connect or publish attempt
+ * @param failures Consecutive failures so far, at least 1
+ * @return MQTT_BACKOFF_MIN_MS doubled per earlier failure up to
+ * MQTT_BACKOFF_MAX_MS, of which a random half, so devices that lost the
+ * broker together do not retry together
+ */
+static uint32_t mqtt_backoff_ms(uint32_t failures) {
+  uint32_t delay_ms = MQTT_BACKOFF_MAX_MS;
+  if (failures <= 16 && ((uint32_t)MQTT_BACKOFF_MIN_MS << (failures - 1)) < MQTT_BACKOFF_MAX_MS) {
+    delay_ms = (uint32_t)MQTT_BACKOFF_MIN_MS << (failures - 1);
+  }
+  return delay_ms / 2 + random(delay_ms / 2 + 1);
+}
+
+/**
+ * @brief Snapshot of the outbound pipeline counters, safe from any task
+ * @note Each counter is read atomically, the set may straddle one publish
+ */
+mqtt_stats_t mqtt_get_stats(void) {
+  mqtt_stats_t stats;
+  stats.published = s_published.load(std::memory_order_relaxed);
+  stats.retried = s_retried.load(std::memory_order_relaxed);
+  stats.dropped = s_dropped.load(std::memory_order_relaxed) + s_outbound.dropped();
+  stats.connects = s_connects.load(std::memory_order_relaxed);
+  stats.connect_failures = s_connect_failures.load(std::memory_order_relaxed);
+  stats.queued = s_outbound.size();
+  return stats;
+}
+
+/**
+ * @brief Network task, the only user of the MQTT client
  * @param pvParameters FreeRTOS task parameters (unused)
+ * @details Connects and subscribes, reconnects and resubscribes whenever the
+ * connection drops, and drains the outbound queue in order. A failed
+ * connect or publish is retried after mqtt_backoff_ms(), the frame stays at
+ * the head of the queue meanwhile, and client.loop() keeps running. The
+ * batching task and everything upstream never wait for the network, a
+ * full queue drops new frames instead.
  */
 void connect_mqtt(void *pvParameters) {
   char clientId[50];
@@ -152,38 +210,68 @@ void connect_mqtt(void *pvParameters) {
   Serial.printf("\n[MQTT] Connecting to %s\n", MQTT_SERVER);
   client.setServer(MQTT_SERVER, MQTT_PORT);
   client.setCallback(callback);
-  client.setSocketTimeout(60);
-
-  while (!client.connect(clientId)) {
-    Serial.printf(".");
-    vTaskDelay(RETRY_DELAY);
-  }
-  // uart_wait_tx_idle_polling((uart_port_t)CONFIG_ESP_CONSOLE_UART_NUM);
-  // esp_sleep_enable_timer_wakeup(1000*1000*1);
-  // esp_light_sleep_start();
+  client.setBufferSize(MSG_BUFFER_SIZE + 64); // A full batch, the topic and the MQTT header
+  client.setSocketTimeout(MQTT_SOCKET_TIMEOUT_S);
 
-  if (!client.connected()) {
-    Serial.printf("[MQTT] Timeout\n");
-    vTaskDelete(NULL);     
-  }
+  xTaskCreate(communication_mqtt_task, "task_publish", 4096, NULL, 1, NULL);
 
-  Serial.printf("[MQTT] Connected\n");
+  outbound_frame_t frame;      // Head of the queue, kept until published
+  bool pending = false;
+  uint8_t tries = 0;           // Failed publishes of the pending frame
+  uint32_t failures = 0;       // Consecutive failed connects or publishes
+  uint32_t retry_ms = millis();
+  bool notified = false;
 
-  Serial.printf("[MQTT] subscribe to topic: %s\n", SUBSCRIBE_TOPIC);
-  client.subscribe(SUBSCRIBE_TOPIC,1);
-  // uart_wait_tx_idle_polling((uart_port_t)CONFIG_ESP_CONSOLE_UART_NUM);
-  // esp_sleep_enable_timer_wakeup(1000*1000*0.5);
-  // esp_light_sleep_start();
-  xTaskNotifyGive(xCommunicationTaskHandle);
-  xTaskCreate(communication_mqtt_task, "task_publish", 4096, NULL, 1, NULL);
-  
-  // Main MQTT maintenance loop
   while (1) {
-    client.loop();
+    const bool due = (int32_t)(millis() - retry_ms) >= 0;
+
+    if (!client.connected()) {
+      if (due) {
+        if (WiFi.status() == WL_CONNECTED && client.connect(clientId)) {
+          Serial.printf("[MQTT] Connected, subscribe to topic: %s\n", SUBSCRIBE_TOPIC);
+          client.subscribe(SUBSCRIBE_TOPIC,1);
+          s_connects.fetch_add(1, std::memory_order_relaxed);
+          failures = 0;
+          if (!notified) {
+            xTaskNotifyGive(xCommunicationTaskHandle);
+            notified = true;
+          }
+        } else {
+          s_connect_failures.fetch_add(1, std::memory_order_relaxed);
+          const uint32_t wait_ms = mqtt_backoff_ms(++failures);
+          retry_ms = millis() + wait_ms;
+          Serial.printf("[MQTT] Connection failed (state %d), retry in %lu ms\n", client.state(), (unsigned long)wait_ms);
+        }
+      }
+    } else {
+      // Publish in order until the queue is empty or a publish fails
+      while (due && (pending || s_outbound.pop(&frame))) {
+        pending = true;
+        payload_set_time(frame.data, millis());
+        if (client.publish(PUBLISH_TOPIC, frame.data, frame.len)) {
+          s_published.fetch_add(1, std::memory_order_relaxed);
+          bytes_sent += frame.len;
+          pending = false;
+          tries = 0;
+          failures = 0;
+          continue;
+        }
+        s_retried.fetch_add(1, std::memory_order_relaxed);
+        if (++tries >= MQTT_PUBLISH_MAX_TRIES) {
+          Serial.printf("[MQTT] Dropping a frame after %u failed publishes\n", tries);
+          s_dropped.fetch_add(1, std::memory_order_relaxed);
+          pending = false;
+          tries = 0;
+        }
+        const uint32_t wait_ms = mqtt_backoff_ms(++failures);
+        retry_ms = millis() + wait_ms;
+        Serial.printf("[MQTT] Publish failed, retry in %lu ms\n", (unsigned long)wait_ms);
+        break;
+      }
+      client.loop();
+    }
     vTaskDelay(MQTT_LOOP);
   }
-
-  vTaskDelete(NULL); 
 }
 
 /**
@@ -196,29 +284,31 @@ void callback(char* topic, byte* message, unsigned int length) {
   //     uart_wait_tx_idle_polling((uart_port_t)CONFIG_ESP_CONSOLE_UART_NUM);
   // esp_sleep_enable_timer_wakeup(1000*1000*0.5);
   // esp_light_sleep_start();
-    StaticJsonDocument<200> doc;
-    DeserializationError error = deserializeJson(doc, message);
+    payload_header_t header;
+    aggregate_record_t records[MQTT_BATCH_RECORDS];
 
-    if (error) {
-        Serial.print(F("deserializeJson() failed: "));
-        Serial.println(error.f_str());
-        vTaskDelete(NULL);
+    // The ack echoes the batch that was published
+    if (!payload_decode(message, length, &header, records, MQTT_BATCH_RECORDS) || header.count == 0 ||
+        header.count > MQTT_BATCH_RECORDS) {
+        Serial.printf("[MQTT] Ignoring malformed ack of %u bytes\n", length);
+        return;
     }
-    
-    int id = doc["id"];
-    float val = doc["value"];
-    unsigned long timestamp = doc["time"];
-
-    Serial.printf("[MQTT] incoming topic = id: %d - avg: %f - timestamp %lu \n",id,val,timestamp);
-    float current_time = millis();
+    bytes_received += length;
 
-    float rtt = (float)( current_time - timestamp); // RTT in seconds
+    unsigned long timestamp = header.time_ms;
+    float rtt = (float)(millis() - header.time_ms); // RTT in ms, shared by the batch
 
+    Serial.printf("[MQTT] incoming topic = ids: %d-%d - timestamp %lu \n",
+                  header.first_id, header.first_id + header.count - 1, timestamp);
     Serial.printf("RTT: %.1f ms\n", rtt);
     
-    rtt_data_array[id] = {id,val,rtt};
+    for (uint8_t k = 0; k < header.count; k++) {
+      int id = header.first_id + k;
+      rtt_data_array[id % SIZE_AVG_ARRAY] = {id,records[k].mean,rtt};
+    }
     
-    if(id >= SIZE_AVG_ARRAY-1){
+    // Report once per SIZE_AVG_ARRAY records, publishing carries on
+    if(header.first_id % SIZE_AVG_ARRAY + header.count >= SIZE_AVG_ARRAY){
       // uart_wait_tx_idle_polling((uart_port_t)CONFIG_ESP_CONSOLE_UART_NUM);
       // esp_sleep_enable_timer_wakeup(1000*1000*1);
       // esp_light_sleep_start();
@@ -229,25 +319,24 @@ void callback(char* topic, byte* message, unsigned int length) {
   }
 
 /**
- * @brief Publishes data to MQTT broker
- * @param val Value to publish
- * @param i Sample index
+ * @brief Queues data for the MQTT broker, never waits for the network
+ * @param records Aggregate records of consecutive windows, published as one message
+ * @param count Number of records, at most MQTT_BATCH_RECORDS
+ * @param i Index of the first window
+ * @return false if the outbound queue was full and the message was dropped
+ * @details Binary frame of payload.h, the network task stamps the send time
+ * that is echoed back for the RTT
  */
-void send_to_mqtt(float val, int i){
-    unsigned long timestamp = millis();
-    snprintf(msg, MSG_BUFFER_SIZE, "{\"id\":%d,\"value\":%.2f,\"time\":%lu}",i,val, timestamp);    
+bool send_to_mqtt(const aggregate_record_t *records, uint8_t count, int i){
+    outbound_frame_t frame;
+    frame.len = payload_encode(frame.data, MSG_BUFFER_SIZE, i, 0, records, count);
     
-    if(client.publish(PUBLISH_TOPIC, msg)){
-      Serial.printf("[MQTT] Publishing average: %s\n", msg);
-    }else{
-      Serial.printf("[MQTT] ERROR while publishing average: %s\n", msg);
-      if (!client.connected()) {
-        vTaskDelete(NULL); 
-      }
+    if(s_outbound.push(frame)){
+      Serial.printf("[MQTT] Queued averages %d-%d: %u bytes\n", i, i + count - 1, frame.len);
+      return true;
     }
-  //   uart_wait_tx_idle_polling((uart_port_t)CONFIG_ESP_CONSOLE_UART_NUM);
-  // esp_sleep_enable_timer_wakeup(1000*1000*0.5);
-  // esp_light_sleep_start();
+    Serial.printf("[MQTT] Outbound queue full, dropping averages %d-%d\n", i, i + count - 1);
+    return false;
 }
 
 /* Data Reporting ----------------------------------------------------------- */
@@ -291,25 +380,35 @@ void print_rtts(){
 /**
  * @brief Handles outgoing MQTT communications
  * @param pvParameters FreeRTOS task parameters (unused)
+ * @details Records are batched and published together once MQTT_BATCH_RECORDS
+ * are waiting or the oldest one waited MQTT_BATCH_DEADLINE_MS, so the radio
+ * wakes and pays the TCP/MQTT overhead once per batch.
  */
 void communication_mqtt_task(void *pvParameters){
-    float val = 0.0;
-    int i = 0;
+    aggregate_record_t batch[MQTT_BATCH_RECORDS];
+    uint8_t batched = 0;
+    TickType_t deadline = 0;
+    uint16_t i = 0;              // Id of the next record, wraps like the payload id
     start_time_communication();
     while(1){
-      if(xQueueReceive(xQueueAvgs, &val, (TickType_t)portMAX_DELAY)) {
-        send_to_mqtt(val,i);
-        i++;
-        if(i >= SIZE_AVG_ARRAY){
-            Serial.print("*************\n");
-            Serial.print("Communication task finished\n");
-            Serial.print("*************\n");
-            // uart_wait_tx_idle_polling((uart_port_t)CONFIG_ESP_CONSOLE_UART_NUM);
-            // esp_sleep_enable_timer_wakeup(1000*1000*2);
-            // esp_light_sleep_start();
-            break;
+      // Wait for the next record, at most until the batch is due
+      TickType_t wait = portMAX_DELAY;
+      if (batched > 0) {
+        const int32_t left = (int32_t)(deadline - xTaskGetTickCount());
+        wait = left > 0 ? (TickType_t)left : 0;
+      }
+      if (g_avg_ring.pop_wait(&batch[batched], wait)) {
+        if (batched == 0) {
+          deadline = xTaskGetTickCount() + pdMS_TO_TICKS(MQTT_BATCH_DEADLINE_MS);
         }
+        batched++;
+      }
+
+      const bool due = batched > 0 && (int32_t)(xTaskGetTickCount() - deadline) >= 0;
+      if (batched == MQTT_BATCH_RECORDS || due) {
+        send_to_mqtt(batch, batched, i);
+        i += batched;
+        batched = 0;
       }
     }
-  vTaskDelete(NULL); 
 }
\ No newline at end of file
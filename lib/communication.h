@@ -17,13 +17,24 @@ struct rtt_data {
     float rtt;
 };
 
+// Outbound pipeline counters
+typedef struct {
+    uint32_t published;          // Frames accepted by the broker
+    uint32_t retried;            // Failed publishes, retried after a backoff
+    uint32_t dropped;            // Frames lost, queue full or MQTT_PUBLISH_MAX_TRIES failures
+    uint32_t connects;           // Successful connections, the first one included
+    uint32_t connect_failures;   // Failed connection attempts
+    uint16_t queued;             // Frames waiting for the network
+} mqtt_stats_t;
+
 // WiFi functions
 void wifi_init();
 
 // MQTT functions
 void connect_mqtt(void *arg);
 void callback(char* topic, byte* message, unsigned int length);
-void send_to_mqtt(float val, int i);
+bool send_to_mqtt(const aggregate_record_t *records, uint8_t count, int i);
+mqtt_stats_t mqtt_get_stats(void);
 
 // Task handlers
 void communication_mqtt_task(void *pvParameters);
@@ -2,15 +2,74 @@
 #define WINDOW_SIZE 5
 
 #define WIFI_MAX_RETRIES 10
-#define MSG_BUFFER_SIZE 50
+#define MSG_BUFFER_SIZE 232 // Largest MQTT message, a batch of MQTT_BATCH_RECORDS binary records
+#define MQTT_BATCH_RECORDS 8 // Records per publish at most, 1 publishes every record at once
+#define MQTT_BATCH_DEADLINE_MS 2000 // Longest a record waits for its batch to fill
+#define MQTT_OUTBOUND_QUEUE 8 // Frames waiting for the network (power of two), new frames are dropped when full
+#define MQTT_BACKOFF_MIN_MS 500 // Retry delay after the first failed connect or publish
+#define MQTT_BACKOFF_MAX_MS 30000 // Retry delay cap, doubled per failure, half of it is jitter
+#define MQTT_PUBLISH_MAX_TRIES 5 // Failed publishes of a frame before it is dropped
+#define MQTT_SOCKET_TIMEOUT_S 5 // Longest a connect or publish blocks the network task
 #define RETRY_DELAY 2000 / portTICK_PERIOD_MS
 #define MQTT_LOOP portTICK_PERIOD_MS
 #define PUBLISH_TOPIC "luca/esp32/data"
 #define SUBSCRIBE_TOPIC "luca/esp32/acks"
 
 #define INIT_SAMPLE_RATE 1000 // Hz
-#define NUM_SAMPLES 1024
-#define QUEUE_SIZE NUM_OF_SAMPLES_AGGREGATE
+#define NYQUIST_MULTIPLIER 2.5f // Sampling rate / max frequency
+#define RATE_MIN 1 // Hz
+#define RATE_MAX INIT_SAMPLE_RATE // Hz
+#define RATE_LOWER_RATIO 0.8f // Lower only if the required rate is below this fraction of the current one
+#define RATE_LOWER_HOLD 2 // Consecutive estimates needed to lower the rate
+#define RATE_MAX_STEP_UP 4 // Largest raise factor per decision
+#define RATE_MAX_STEP_DOWN 4 // Largest lowering factor per decision
+#define RATE_ALIAS_FRACTION 0.9f // Peaks above this fraction of Nyquist may be aliased
+#define RATE_CHANGE_TOLERANCE 0.1f // Relative estimate change treated as a new regime
+#define NUM_SAMPLES 1024 // FFT size (power of two), peak interpolation keeps sub-bin accuracy when reduced
+#define PEAK_INTERP_NONE 0
+#define PEAK_INTERP_QUADRATIC 1
+#define PEAK_INTERP_GAUSSIAN 2
+#define PEAK_INTERPOLATION PEAK_INTERP_GAUSSIAN // Sub-bin refinement of the max frequency peak
+#define NOISE_SNR_MARGIN 5.0f // Peak to median bin magnitude ratio for a component
+#define NOISE_DYNAMIC_RANGE 0.01f // Weakest component relative to the strongest bin (-40 dB)
+#define FFT_WINDOW_TYPE FFT_WINDOW_HAMMING
+#define FFT_FIXED_POINT 0 // 1: integer samples, Q15 FFT, integer peak search
+#define ADC_RESOLUTION_BITS 12
+#define FIXED_SAMPLE_SCALE 100 // ADC codes per signal unit
+#define SDFT_WINDOW_SIZE 64 // Streaming spectrum length (power of two)
+#define SDFT_MIN_AMPLITUDE 0.5f // Peak amplitude floor of the streaming spectrum
+#define SDFT_IN_SAMPLING_TASK 0 // 1: fft_sampling_task() also feeds the streaming spectrum, unused by the ping-pong analysis
+#define SPECTRAL_BLOCK_SIZE 32 // Samples per feature vector of the change detector
+#define SPECTRAL_BANDS 4 // Goertzel bands of the change detector, spread up to Nyquist
+#define SPECTRAL_LEARN_BLOCKS 16 // Blocks that set the reference spectrum after a reset
+#define SPECTRAL_MIN_SPREAD 0.02f // Floor of the learnt feature spread
+#define CUSUM_SLACK 1.0f // Tolerated feature shift, in learnt spreads per block
+#define CUSUM_THRESHOLD 8.0f // Accumulated shift that signals a change, in spreads
+#define HISTORY_SIZE 128 // Timestamped samples kept, a re-analysis waits for this many of the new spectrum
+#define HISTORY_MIN_SAMPLES 64 // Fewer samples leave the history inconclusive
+#define HISTORY_OVERSAMPLING 4 // Periodogram frequencies per 1/span of the history
+#define HISTORY_SNR_MARGIN 10.0f // Peak to median periodogram power ratio for a component
+#define HISTORY_DYNAMIC_RANGE 0.002f // Weakest peak power relative to the strongest (-27 dB)
+#define HISTORY_MIN_CYCLES 2 // Cycles over the history span needed to trust a peak
+#define HISTORY_BURST_CYCLES 8 // Burst cycles at the top of the history band, sets the burst length
+#define HISTORY_MIN_BURST 64 // Shortest burst above the history band (power of two)
+#define FFT_ANALYSIS_CORE 0 // Core of the block analysis task, sampling runs on the other one
+#define FFT_ANALYSIS_STACK_SIZE 4096 // Bytes
+#define SAMPLING_MAX_SAMPLES 0 // Samples before the sampling task stops, 0 samples for ever, else at least NUM_SAMPLES
+#define SIGNAL_MAX_TONES 4 // Tones per synthetic signal
+#define SIGNAL_RESYNC_INTERVAL 1024 // Samples between exact recomputations of the tone phasors
+#define SAMPLE_BLOCK_SIZE 128 // Samples per transport block, latency = size / rate
+#define SAMPLE_BLOCK_COUNT 4 // Blocks in the transport pool (power of two)
+#define AVG_RING_SIZE 32 // Averages buffered for the transmission task (power of two)
+#define TIME_WINDOW_KIND TIME_WINDOW_SLIDING // TIME_WINDOW_TUMBLING, TIME_WINDOW_HOPPING or TIME_WINDOW_SLIDING
+#define TIME_WINDOW_SIZE_MS 500 // Aggregation window length
+#define TIME_WINDOW_HOP_MS 250 // Time between window starts of hopping windows
+#define TIME_WINDOW_SLIDING_PANES 5 // Steps per window length of sliding windows
+#define TIME_WINDOW_MAX_PANES 32 // Pane ring length, bounds size / gcd(size, hop)
+#define ROLLUP_PERIODS_MS {1000, 10000, 60000} // Rollup resolutions, finest first, each divides the next
+#define ROLLUP_CAPACITY 60 // Buckets kept per rollup resolution
+#define QUANTILE_SKETCH_K 64 // Capacity of the top compactor, rank error near 1/K
+#define QUANTILE_SKETCH_MAX_LEVELS 20 // Compactors, a sketch holds about K * 2^levels samples
 
 #define NUM_OF_SAMPLES_AGGREGATE 20
-#define SIZE_AVG_ARRAY NUM_OF_SAMPLES_AGGREGATE-WINDOW_SIZE+1
+#define SIZE_AVG_ARRAY (NUM_OF_SAMPLES_AGGREGATE-WINDOW_SIZE+1)
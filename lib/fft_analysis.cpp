@@ -1,31 +1,55 @@
 #include "fft_analysis.h"
 #include <Arduino.h>
-#include <arduinoFFT.h>
 #include <math.h>
+#include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "config.h"
 #include "shared_defs.h"
-#define NOISE_THRESHOLD 8
+#include "fft_plan.h"
+#include "sliding_dft.h"
+#include "noise_floor.h"
+#include "sample_scheduler.h"
+#include "sample_source.h"
+#include "block_pipeline.h"
 
+#if FFT_FIXED_POINT
+// ADC codes are scaled up to fill the Q15 input range
+#define FFT_INPUT_SHIFT (15 - ADC_RESOLUTION_BITS)
+#endif
 
-/// @brief Real component buffer for FFT input
-float g_samples_real[NUM_SAMPLES] = {0};
 
-/// @brief Imaginary component buffer for FFT input
-float g_samples_imag[NUM_SAMPLES] = {0};
+/// @brief Real sample buffer for FFT input, holds magnitudes after analysis
+fft_sample_t g_samples_real[NUM_SAMPLES] = {0};
 
 /// @brief Current system sampling frequency (Hz)
-int g_sampling_frequency = INIT_SAMPLE_RATE;
+std::atomic<int> g_sampling_frequency(INIT_SAMPLE_RATE);
 
-/// @brief ArduionFFT instance configured with buffers
-ArduinoFFT<float> FFT = ArduinoFFT<float>(
-    g_samples_real, 
-    g_samples_imag, 
-    NUM_SAMPLES, 
-    g_sampling_frequency
-);
+/// @brief FFT plan with compile-time window and twiddle tables
+#if FFT_FIXED_POINT
+typedef FftPlanQ15<NUM_SAMPLES, FFT_WINDOW_TYPE, FFT_INPUT_SHIFT> fft_plan_t;
+#else
+typedef FftPlan<NUM_SAMPLES, FFT_WINDOW_TYPE> fft_plan_t;
+#endif
 
+/// @brief Streaming spectrum of the normal sample stream
+static sliding_dft_t g_spectrum;
+
+/// @brief Decides rate changes from max frequency estimates, the first one calibrates it
+static rate_controller_t g_rate_controller;
+
+/// @brief Guards the controller and rate updates, which may come from both cores
+static portMUX_TYPE g_rate_mux = portMUX_INITIALIZER_UNLOCKED;
+
+/// @brief Set when the rate changed, the sampling side restarts the streaming spectrum
+static volatile bool g_spectrum_stale = false;
+
+/// @brief Second acquisition block, g_samples_real is the first one
+static fft_sample_t g_samples_pong[NUM_SAMPLES] = {0};
+
+static_assert(SAMPLING_MAX_SAMPLES == 0 || SAMPLING_MAX_SAMPLES >= NUM_SAMPLES, "SAMPLING_MAX_SAMPLES must fill an analysis block");
+
+sample_source_t *g_sample_source = NULL;
 signal_function curr_signal = signal_low_freq;
 
 /* Signal Generation ------------------------------------------------------- */
@@ -50,6 +74,36 @@ float signal_high_freq(float t) {
   return 4 * sin(2 * PI * 350 * t) + 2 * sin(2 * PI * 300 * t);
 }
 
+// Tones of the built-in signals, {amplitude, frequency, phase}
+static const tone_t LOW_FREQ_TONES[] = {{2, 3, 0}, {4, 5, 0}};
+static const tone_t CHANGED_TONES[] = {{10, 2, 0}, {6, 9, 0}};
+static const tone_t MEDIUM_FREQ_TONES[] = {{8, 100, 0}, {3, 150, 0}};
+static const tone_t HIGH_FREQ_TONES[] = {{4, 350, 0}, {2, 300, 0}};
+
+/**
+ * @brief Tone description of a built-in signal
+ * @param sig_func Signal generation function pointer
+ * @param desc Filled with the tones of sig_func
+ * @return false for functions that are not known sums of tones
+ */
+bool signal_describe(signal_function sig_func, signal_desc_t *desc) {
+  const tone_t *tones = NULL;
+  if (sig_func == signal_low_freq) {
+    tones = LOW_FREQ_TONES;
+  } else if (sig_func == signal_changed) {
+    tones = CHANGED_TONES;
+  } else if (sig_func == signal_medium_freq) {
+    tones = MEDIUM_FREQ_TONES;
+  } else if (sig_func == signal_high_freq) {
+    tones = HIGH_FREQ_TONES;
+  } else {
+    return false;
+  }
+  desc->tones = tones;
+  desc->num_tones = 2;
+  return true;
+}
+
 
 
 /* Sampling Functions ------------------------------------------------------ */
@@ -58,71 +112,227 @@ float signal_high_freq(float t) {
  * @param sig_func Signal generation function pointer
  * @param index Sample index
  * @param sample_rate Sampling frequency in Hz
- * @return Sampled value at time t = index/sample_rate
+ * @return Sampled value at time t = index/sample_rate, as an ADC code when
+ * FFT_FIXED_POINT is set
  */
-float sample_signal(signal_function sig_func, int index, int sample_rate) {
+fft_sample_t sample_signal(signal_function sig_func, int index, int sample_rate) {
     const float t = (float)index / sample_rate;
-    return sig_func(t);
+    return sample_from_float(sig_func(t));
+}
+
+/**
+ * @brief Open a built-in signal as a source
+ * @param src Source state
+ * @param sig_func Signal generation function pointer
+ * @note Built-in signals come from the phasor generator, others are evaluated
+ * for every sample
+ */
+static void fft_open_signal(sample_source_t *src, signal_function sig_func) {
+    signal_desc_t desc;
+    const bool phasor = signal_describe(sig_func, &desc);
+    sample_source_open_synthetic(src, sig_func, phasor ? &desc : NULL, g_sampling_frequency, 0, true);
+}
+
+/**
+ * @brief Acquire a block for FFT processing from a source
+ * @param src Sample source, read at g_sampling_frequency
+ * @param num_samples Number of samples to acquire
+ * @return Samples acquired, the rest of the block is zeroed
+ * @note The source is paused afterwards and may be read from another task
+ */
+int fft_process_source(sample_source_t *src, int num_samples) {
+    // The burst interrupts the normal stream
+    sdft_reset(&g_spectrum);
+    sample_source_set_rate(src, g_sampling_frequency);
+    const int n = sample_source_read(src, g_samples_real, num_samples);
+    sample_source_pause(src);
+    for (int i = n; i < num_samples; i++) {
+        g_samples_real[i] = 0;
+    }
+    return n;
 }
 
 /**
  * @brief Perform signal acquisition for FFT processing
  * @param sig_func Signal generation function pointer
  * @param num_samples Number of samples to acquire
+ * @note Paced by absolute timer deadlines (sample_scheduler.h). Built-in
+ * signals come from the phasor generator instead of a sin() per sample.
  */
 void fft_process_signal(signal_function sig_func,int num_samples) {
-    for (int i = 0; i < num_samples; i++) {
-        g_samples_real[i] = sample_signal(sig_func, i, g_sampling_frequency);
-        vTaskDelay(pdMS_TO_TICKS(1000/g_sampling_frequency));
-    }
+    sample_source_t src;
+    fft_open_signal(&src, sig_func);
+    fft_process_source(&src, num_samples);
+    sample_source_close(&src);
 }
 
 /* FFT Processing Core ----------------------------------------------------- */
+/**
+ * @brief Window, transform and take magnitudes of one block in place
+ * @param data NUM_SAMPLES samples, magnitudes of bins 0..NUM_SAMPLES/2 on return
+ */
+static void fft_analyse_block(fft_sample_t *data) {
+    fft_plan_t::window(data);
+    fft_plan_t::forward(data);
+    fft_plan_t::magnitude(data);
+}
+
+/**
+ * @brief Highest spectral peak of an analysed block
+ * @param data Magnitudes from fft_analyse_block(), upper half is overwritten
+ * @param sampling_frequency Rate the block was acquired at (Hz)
+ * @return Frequency (Hz), -1 if no peak clears the noise floor
+ */
+static float fft_block_max_frequency(fft_sample_t *data, int sampling_frequency) {
+  int maxBin = -1;
+  const float noise_floor = spectrum_noise_floor(data, NUM_SAMPLES);
+
+  // Loop through all bins (skip DC at i=0), highest peak bin wins
+  for (uint16_t i = 1; i < (NUM_SAMPLES >> 1); i++) {
+    // Check if the current bin is a local maximum and above the noise floor
+    if (data[i] > data[i-1] && data[i] > data[i+1] && data[i] > noise_floor) {
+      maxBin = i;
+    }
+  }
+  if (maxBin < 0) {
+    return -1;
+  }
+  const float offset = fft_peak_offset(data[maxBin-1], data[maxBin], data[maxBin+1]);
+  return (maxBin + offset) * sampling_frequency / NUM_SAMPLES;
+}
+
 /**
  * @brief Execute complete FFT processing chain
  * @details Performs:
- * 1. Hamming window application
- * 2. Forward FFT computation
+ * 1. Window application (FFT_WINDOW_TYPE)
+ * 2. Forward real-input FFT computation
  * 3. Complex-to-magnitude conversion
- * @note Results stored in module buffers
+ * @note Tables are precomputed in flash, only the butterflies run here
+ * @note Magnitudes of bins 0..NUM_SAMPLES/2 stored in g_samples_real
  */
 void fft_perform_analysis(void) {
-    FFT.windowing(FFT_WIN_TYP_HAMMING, FFT_FORWARD);
-    FFT.compute(FFT_FORWARD);
-    FFT.complexToMagnitude();
+    fft_analyse_block(g_samples_real);
 }
 
 /**
  * @brief Identify max frequency component
- * @return Frequency (Hz) of highest frequency
+ * @return Frequency (Hz) of highest frequency, refined between bins with
+ * PEAK_INTERPOLATION, -1 if no peak clears the noise floor
  * @pre Requires prior call to fft_perform_analysis()
+ * @note The noise floor is estimated from the spectrum itself (noise_floor.h),
+ * the upper half of g_samples_real is overwritten
  */
 float fft_get_max_frequency(void) {
-  double maxFrequency = -1;
-
-  // Loop through all bins (skip DC at i=0)
-  for (uint16_t i = 1; i < (NUM_SAMPLES >> 1); i++) {
-    // Check if the current bin is a local maximum and above the noise floor
-    if (g_samples_real[i] > g_samples_real[i-1] && g_samples_real[i] > g_samples_real[i+1] && g_samples_real[i] > NOISE_THRESHOLD) {
-      double currentFreq = (i * g_sampling_frequency) / NUM_SAMPLES;
-      // Update maxFrequency if this peak has a higher frequency
-      if (currentFreq > maxFrequency) {
-        maxFrequency = currentFreq;
-      }
-    }
-  }
-  return maxFrequency;
+    return fft_block_max_frequency(g_samples_real, g_sampling_frequency);
 }
 
 /* System Configuration ---------------------------------------------------- */
 /**
  * @brief Adapt sampling rate based on Nyquist-Shannon criteria
  * @param max_freq Max detected frequency component
- * @note Implements safety factor of 2.5× maximum frequency
+ * @note Implements safety factor of NYQUIST_MULTIPLIER × maximum frequency,
+ * raising and lowering through the rate controller (rate_controller.h)
+ * @note Keeps the current rate if no component was found (max_freq <= 0)
  */
 void fft_adjust_sampling_rate(float max_freq) {
-    const int new_rate = (int)(NYQUIST_MULTIPLIER * max_freq);
-    g_sampling_frequency = (g_sampling_frequency > new_rate) ? new_rate : g_sampling_frequency;
+    portENTER_CRITICAL(&g_rate_mux);
+    const rate_decision_t decision = rate_controller_update(&g_rate_controller, g_sampling_frequency, max_freq);
+    g_sampling_frequency = decision.rate;
+    portEXIT_CRITICAL(&g_rate_mux);
+
+    // Streaming bins are spaced by the sampling rate, start over on change
+    if (decision.action != RATE_HOLD) {
+        g_spectrum_stale = true;
+    }
+}
+
+/**
+ * @brief Last decision taken by fft_adjust_sampling_rate()
+ */
+const rate_decision_t *fft_last_rate_decision(void) {
+    return rate_controller_last(&g_rate_controller);
+}
+
+/* Streaming Spectrum ------------------------------------------------------ */
+/**
+ * @brief Feed one sample of the normal stream to the streaming spectrum
+ * @param sample Sample taken at g_sampling_frequency
+ * @note O(SDFT_WINDOW_SIZE/2) per call
+ */
+void fft_streaming_update(float sample) {
+    if (g_spectrum_stale) {
+        g_spectrum_stale = false;
+        sdft_reset(&g_spectrum);
+    }
+    sdft_update(&g_spectrum, sample);
+}
+
+/**
+ * @brief Max frequency seen by the streaming spectrum
+ * @return Frequency (Hz), -1 until SDFT_WINDOW_SIZE samples were fed at the
+ * current rate or if no peak clears SDFT_MIN_AMPLITUDE
+ * @note Only content below g_sampling_frequency/2 is visible, a peak close
+ * to it is handled by the rate controller alias guard
+ */
+float fft_streaming_max_frequency(void) {
+    return sdft_max_frequency(&g_spectrum, g_sampling_frequency);
+}
+
+/**
+ * @brief Adapt sampling rate from the streaming spectrum
+ * @return true if the rate was re-evaluated without an acquisition burst,
+ * false if the streaming spectrum has no estimate yet and the caller has to
+ * fall back to a full FFT acquisition
+ */
+bool fft_streaming_adjust_sampling_rate(void) {
+    const float max_freq = fft_streaming_max_frequency();
+    if (max_freq <= 0) {
+        return false;
+    }
+    fft_adjust_sampling_rate(max_freq);
+    return true;
+}
+
+/* Ping-Pong Acquisition --------------------------------------------------- */
+/**
+ * @brief Analyse one full block of the stream, runs on FFT_ANALYSIS_CORE
+ * @param data Block from the ping-pong pipeline (block_pipeline.h)
+ * @param sampling_frequency Rate the block was acquired at (Hz)
+ * @details Transforms the block and hands the estimate to the rate controller
+ */
+static void fft_analyse_stream_block(fft_sample_t *data, int sampling_frequency) {
+    fft_analyse_block(data);
+    const float peak_freq = fft_block_max_frequency(data, sampling_frequency);
+
+    // A block taken at a rate that is no longer current is stale
+    if (sampling_frequency == g_sampling_frequency) {
+        fft_adjust_sampling_rate(peak_freq);
+    }
+}
+
+/**
+ * @brief Start continuous analysis of the sample stream
+ * @note Blocks are analysed on FFT_ANALYSIS_CORE, the sampling task should
+ * run on the other core so that it never waits for a transform
+ */
+void fft_pipeline_start(void) {
+    block_pipeline_start(g_samples_real, g_samples_pong, fft_analyse_stream_block);
+}
+
+/**
+ * @brief Append a sample of the normal stream to the acquisition block
+ * @param sample Sample taken at g_sampling_frequency
+ * @note Never waits, see block_pipeline_push()
+ */
+void fft_pipeline_push(fft_sample_t sample) {
+    block_pipeline_push(sample, g_sampling_frequency);
+}
+
+/**
+ * @brief Snapshot of the ping-pong acquisition statistics
+ */
+fft_pipeline_stats_t fft_pipeline_get_stats(void) {
+    return block_pipeline_get_stats();
 }
 
 /**
@@ -131,13 +341,20 @@ void fft_adjust_sampling_rate(float max_freq) {
  * 1. Initial signal acquisition
  * 2. Frequency analysis
  * 3. Adaptive rate configuration
+ * 4. Start of the ping-pong analysis on FFT_ANALYSIS_CORE
  * @note Must be called before starting sampling tasks
+ * @note Start-up only, afterwards g_samples_real belongs to the ping-pong
+ * acquisition and the rate is re-evaluated from the stream
  */
 void fft_init(void) {
     Serial.println("[FFT] Initializing FFT module");
     
-    // Initial analysis with default signal
-    fft_process_signal(curr_signal,NUM_SAMPLES);
+    // Initial analysis with the configured input
+    if (g_sample_source != NULL) {
+        fft_process_source(g_sample_source, NUM_SAMPLES);
+    } else {
+        fft_process_signal(curr_signal,NUM_SAMPLES);
+    }
     fft_perform_analysis();
     
     // Adaptive rate adjustment
@@ -145,35 +362,72 @@ void fft_init(void) {
     Serial.printf("[FFT] Peak frequency: %.2f Hz\n", peak_freq);
 
     fft_adjust_sampling_rate(peak_freq);
-    Serial.printf("[FFT] Optimal sampling rate: %d Hz\n", g_sampling_frequency);
+    Serial.printf("[FFT] Optimal sampling rate: %d Hz (%s)\n", g_sampling_frequency.load(), rate_reason_name(fft_last_rate_decision()->reason));
+
+    // From here on the stream itself is analysed, without acquisition bursts
+    fft_pipeline_start();
 }
 
 /**
  * @brief Main sampling task handler
  * @param pvParameters FreeRTOS task parameters (unused)
  * @details
- * - Generates signal samples at configured rate
- * - Pushes samples to processing queue
- * - Self-terminates after acquiring NUM_OF_SAMPLES_AGGREGATE
+ * - Reads g_sample_source, or curr_signal if none is set, at the configured
+ *   rate; paced sources follow rate changes on absolute timer deadlines
+ * - Pushes samples to the aggregation task in blocks (sample_blocks.h)
+ * - Feeds the ping-pong analysis blocks, and the streaming spectrum if
+ *   SDFT_IN_SAMPLING_TASK
+ * - Runs until SAMPLING_MAX_SAMPLES, for ever if 0, and logs the first
+ *   NUM_OF_SAMPLES_AGGREGATE samples
  * 
- * @warning Depends on initialized queue (xQueueSamples)
+ * @warning Depends on initialized block pool (init_shared_queues())
  */
 void fft_sampling_task(void *pvParameters) {
-    float sample = 0.0f;
+    fft_sample_t sample = 0;
+    sample_block_writer_t writer = {0};
+    sample_source_t synthetic;
+    sample_source_t *src = g_sample_source;
+    if (src == NULL) {
+        fft_open_signal(&synthetic, curr_signal);
+        src = &synthetic;
+    }
     
-    Serial.printf("[SAMPLING] Starting sampling at %d Hz\n", g_sampling_frequency);
+    Serial.printf("[SAMPLING] Starting sampling at %d Hz\n", g_sampling_frequency.load());
     Serial.println("--------------------------------");
 
-    for (int i = 0; i < NUM_OF_SAMPLES_AGGREGATE; i++) {
-        sample = sample_signal(curr_signal, i, g_sampling_frequency);
+    uint32_t i;
+    for (i = 0; SAMPLING_MAX_SAMPLES == 0 || i < SAMPLING_MAX_SAMPLES; i++) {
+        const int rate = g_sampling_frequency.load(std::memory_order_relaxed);
+        sample_source_set_rate(src, rate);
+        if (sample_source_read(src, &sample, 1) == 0) {
+            break;
+        }
         
-        xQueueSend(xQueueSamples, &sample, 0);
+        sample_writer_push(&writer, sample, rate);
+#if SDFT_IN_SAMPLING_TASK
+        fft_streaming_update(sample_to_float(sample));
+#endif
+        block_pipeline_push(sample, rate);
 
-        Serial.printf("[SAMPLING] Sample %d: %.2f\n", i, sample);
-        vTaskDelay(pdMS_TO_TICKS(1000/g_sampling_frequency));
+        if (i < NUM_OF_SAMPLES_AGGREGATE) {
+            Serial.printf("[SAMPLING] Sample %lu: %.2f\n", (unsigned long)i, sample_to_float(sample));
+        }
+    }
+    const uint32_t missed = src->sched.missed;
+    if (src == &synthetic) {
+        sample_source_close(src);
+    } else {
+        sample_source_pause(src);
     }
+    sample_writer_flush(&writer);
 
     Serial.println("--------------------------------");
-    Serial.println("[SAMPLING] Sampling completed");
+    Serial.printf("[SAMPLING] Sampling completed from %s source, %lu samples, %lu periods missed, %lu samples dropped\n",
+                  src->name, (unsigned long)i, (unsigned long)missed, (unsigned long)writer.dropped);
+    const fft_pipeline_stats_t stats = fft_pipeline_get_stats();
+    Serial.printf("[SAMPLING] Blocks analysed %lu, dropped %lu, restarted %lu, max gap %lu us, max latency %lu us\n",
+                  (unsigned long)stats.blocks_analysed, (unsigned long)stats.blocks_dropped,
+                  (unsigned long)stats.blocks_restarted, (unsigned long)stats.max_sample_gap_us,
+                  (unsigned long)stats.max_latency_us);
     vTaskDelete(NULL);
 }
\ No newline at end of file
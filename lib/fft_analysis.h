@@ -1,30 +1,46 @@
 #pragma once
-#include <arduinoFFT.h>
+#include <Arduino.h>
+#include <atomic>
 #include "config.h"
+#include "fixed_point.h"
+#include "rate_controller.h"
+#include "signal_generator.h"
+#include "sample_source.h"
+#include "block_pipeline.h"
 
 // Mathematical constants
 #define PI 3.14159265358979323846f
-#define NYQUIST_MULTIPLIER 2.5f
 
 // FFT configuration
-extern float g_samples_real[NUM_SAMPLES];
-extern float g_samples_imag[NUM_SAMPLES];
-extern int g_sampling_frequency;
-extern ArduinoFFT<float> FFT;
+extern fft_sample_t g_samples_real[NUM_SAMPLES];
+extern std::atomic<int> g_sampling_frequency;  // Written by the analysis task, read by the sampler
+
+// Ping-pong acquisition statistics
+typedef block_pipeline_stats_t fft_pipeline_stats_t;
 
 // Signal type
 typedef float (*signal_function)(float t);
 extern signal_function curr_signal;
+extern sample_source_t *g_sample_source;  // Input of fft_init and fft_sampling_task, NULL for curr_signal
 // Public API
 float signal_1(float t);
 float signal_medium_freq(float t);
 float signal_low_freq(float t);
 float signal_high_freq(float t);
 float signal_1_changed(float t);
-float sample_signal(signal_function sig_func, int index, int sample_rate);
+bool signal_describe(signal_function sig_func, signal_desc_t *desc);
+fft_sample_t sample_signal(signal_function sig_func, int index, int sample_rate);
 void fft_init(void);
 void fft_process_signal(signal_function sig_func, int num_samples);
+int fft_process_source(sample_source_t *src, int num_samples);
 float fft_get_max_frequency(void);
 void fft_perform_analysis(void);
 void fft_adjust_sampling_rate(float max_freq);
+const rate_decision_t *fft_last_rate_decision(void);
+void fft_streaming_update(float sample);
+float fft_streaming_max_frequency(void);
+bool fft_streaming_adjust_sampling_rate(void);
+void fft_pipeline_start(void);
+void fft_pipeline_push(fft_sample_t sample);
+fft_pipeline_stats_t fft_pipeline_get_stats(void);
 void fft_sampling_task(void *pvParameters);
\ No newline at end of file
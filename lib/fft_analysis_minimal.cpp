@@ -1,7 +1,6 @@
 #include <cmath>
 #include "fft_analysis_minimal.h"
 #include <Arduino.h>
-#include <arduinoFFT.h>
 #include <math.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -9,20 +8,26 @@
 #include "esp_sleep.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "fft_plan.h"
+#include "sliding_dft.h"
+#include "noise_floor.h"
+#include "sample_scheduler.h"
 
-#define NOISE_THRESHOLD  8
 
-/// @brief Real component buffer for FFT input
+/// @brief Real sample buffer for FFT input, holds magnitudes after analysis
 float g_samples_real[NUM_SAMPLES] = {0};
 
-/// @brief Imaginary component buffer for FFT input
-float g_samples_imag[NUM_SAMPLES] = {0};
-
 /// @brief Current system sampling frequency (Hz)
 int g_sampling_frequency = INIT_SAMPLE_RATE;
 
-/// @brief ArduionFFT instance configured with buffers
+/// @brief FFT plan with compile-time window and twiddle tables
+typedef FftPlan<NUM_SAMPLES, FFT_WINDOW_TYPE> fft_plan_t;
+
+/// @brief Streaming spectrum of the normal sample stream
+static sliding_dft_t g_spectrum;
 
+/// @brief Decides rate changes from max frequency estimates, the first one calibrates it
+static rate_controller_t g_rate_controller;
 
 
 /* Signal Generation ------------------------------------------------------- */
@@ -65,18 +70,29 @@ float sample_signal(signal_function sig_func, int index, int sample_rate) {
  * @brief Perform signal acquisition for FFT processing
  * @param sig_func Signal generation function pointer
  * @param num_samples Number of samples to acquire
+ * @note Entries from num_samples on are zeroed, a short burst comes out zero-padded
+ * @note Light sleep runs until an absolute deadline, so the time spent
+ * sampling and flushing the UART does not stretch the period
  */
 void fft_process_signal(signal_function sig_func,int num_samples) {
-    for( int i= 0; i< num_samples;i++){
+    const uint32_t period_us = sample_period_us(g_sampling_frequency);
+    int64_t deadline = esp_timer_get_time();
+
+    // The burst interrupts the normal stream
+    sdft_reset(&g_spectrum);
+    for (int i = num_samples; i < NUM_SAMPLES; i++) {
         g_samples_real[i] = 0;
-        g_samples_imag[i] = 0;
     }
     for (int i = 0; i < num_samples; i++) {
         g_samples_real[i] = sample_signal(sig_func, i, g_sampling_frequency);
         //Serial.printf("[FFT] %.2f \n",g_samples_real[i]);
         uart_wait_tx_idle_polling((uart_port_t)CONFIG_ESP_CONSOLE_UART_NUM);
-        esp_sleep_enable_timer_wakeup(1000*1000*1/g_sampling_frequency);
-        esp_light_sleep_start();
+        deadline += period_us;
+        const int64_t remaining = deadline - esp_timer_get_time();
+        if (remaining > 0) {
+            esp_sleep_enable_timer_wakeup(remaining);
+            esp_light_sleep_start();
+        }
     }
 }
 
@@ -84,54 +100,127 @@ void fft_process_signal(signal_function sig_func,int num_samples) {
 /**
  * @brief Execute complete FFT processing chain
  * @details Performs:
- * 1. Hamming window application
- * 2. Forward FFT computation
+ * 1. Window application (FFT_WINDOW_TYPE)
+ * 2. Forward real-input FFT computation
  * 3. Complex-to-magnitude conversion
- * @note Results stored in module buffers
+ * @note Tables are precomputed in flash, only the butterflies run here
+ * @note Magnitudes of bins 0..NUM_SAMPLES/2 stored in g_samples_real
  */
 float fft_perform_analysis(void) {
-    ArduinoFFT<float> FFT = ArduinoFFT<float>(
-    g_samples_real, 
-    g_samples_imag, 
-    NUM_SAMPLES, 
-    g_sampling_frequency);
-    FFT.windowing(FFT_WIN_TYP_HAMMING, FFT_FORWARD);
-    FFT.compute(FFT_FORWARD);
-    FFT.complexToMagnitude();
+    fft_plan_t::window(g_samples_real);
+    fft_plan_t::forward(g_samples_real);
+    fft_plan_t::magnitude(g_samples_real);
+    return fft_get_max_frequency();
+}
+
+/**
+ * @brief FFT of a short burst zero-padded to NUM_SAMPLES
+ * @param num_samples Samples acquired by fft_process_signal(), up to NUM_SAMPLES
+ * @details The window (FFT_WINDOW_TYPE) spans the acquired samples only and
+ * is computed here, the padding interpolates their spectrum onto the
+ * NUM_SAMPLES bin grid so the usual peak search applies. Resolution stays
+ * that of the short burst.
+ */
+float fft_perform_burst_analysis(int num_samples) {
+    if (num_samples >= NUM_SAMPLES) {
+        return fft_perform_analysis();
+    }
+    for (int i = 0; i < num_samples; i++) {
+        const float c = cosf(2 * PI * i / (num_samples - 1));
+        g_samples_real[i] *= FFT_WINDOW_TYPE == FFT_WINDOW_HAMMING ? 0.54f - 0.46f * c
+                           : FFT_WINDOW_TYPE == FFT_WINDOW_HANN    ? 0.5f - 0.5f * c
+                           : 1.0f;
+    }
+    fft_plan_t::forward(g_samples_real);
+    fft_plan_t::magnitude(g_samples_real);
     return fft_get_max_frequency();
 }
 
 /**
  * @brief Identify max frequency component
- * @return Frequency (Hz) of highest frequency
+ * @return Frequency (Hz) of highest frequency, refined between bins with
+ * PEAK_INTERPOLATION, -1 if no peak clears the noise floor
  * @pre Requires prior call to fft_perform_analysis()
+ * @note The noise floor is estimated from the spectrum itself (noise_floor.h),
+ * the upper half of g_samples_real is overwritten
  */
 float fft_get_max_frequency(void) {
-  double maxFrequency = -1;
+  int maxBin = -1;
+  const float noise_floor = spectrum_noise_floor(g_samples_real, NUM_SAMPLES);
 
-  // Loop through all bins (skip DC at i=0)
+  // Loop through all bins (skip DC at i=0), highest peak bin wins
   for (uint16_t i = 1; i < (NUM_SAMPLES >> 1); i++) {
     // Check if the current bin is a local maximum and above the noise floor
-    if (g_samples_real[i] > g_samples_real[i-1] && g_samples_real[i] > g_samples_real[i+1] && g_samples_real[i] > NOISE_THRESHOLD) {
-      double currentFreq = (i * g_sampling_frequency) / NUM_SAMPLES;
-      // Update maxFrequency if this peak has a higher frequency
-      if (currentFreq > maxFrequency) {
-        maxFrequency = currentFreq;
-      }
+    if (g_samples_real[i] > g_samples_real[i-1] && g_samples_real[i] > g_samples_real[i+1] && g_samples_real[i] > noise_floor) {
+      maxBin = i;
     }
   }
-  return maxFrequency;
+  if (maxBin < 0) {
+    return -1;
+  }
+  const float offset = fft_peak_offset(g_samples_real[maxBin-1], g_samples_real[maxBin], g_samples_real[maxBin+1]);
+  return (maxBin + offset) * g_sampling_frequency / NUM_SAMPLES;
 }
 
 /* System Configuration ---------------------------------------------------- */
 /**
  * @brief Adapt sampling rate based on Nyquist-Shannon criteria
  * @param max_freq Max detected frequency component
- * @note Implements safety factor of 2.5× maximum frequency
+ * @note Implements safety factor of NYQUIST_MULTIPLIER × maximum frequency,
+ * raising and lowering through the rate controller (rate_controller.h)
+ * @note Keeps the current rate if no component was found (max_freq <= 0)
  */
 void fft_adjust_sampling_rate(float max_freq) {
-    const int new_rate = (int)(NYQUIST_MULTIPLIER * max_freq);
-    g_sampling_frequency = (g_sampling_frequency > new_rate) ? new_rate : g_sampling_frequency;
+    const rate_decision_t decision = rate_controller_update(&g_rate_controller, g_sampling_frequency, max_freq);
+    g_sampling_frequency = decision.rate;
+
+    // Streaming bins are spaced by the sampling rate, start over on change
+    if (decision.action != RATE_HOLD) {
+        sdft_reset(&g_spectrum);
+    }
+}
+
+/**
+ * @brief Last decision taken by fft_adjust_sampling_rate()
+ */
+const rate_decision_t *fft_last_rate_decision(void) {
+    return rate_controller_last(&g_rate_controller);
+}
+
+/* Streaming Spectrum ------------------------------------------------------ */
+/**
+ * @brief Feed one sample of the normal stream to the streaming spectrum
+ * @param sample Sample taken at g_sampling_frequency
+ * @note O(SDFT_WINDOW_SIZE/2) per call
+ */
+void fft_streaming_update(float sample) {
+    sdft_update(&g_spectrum, sample);
+}
+
+/**
+ * @brief Max frequency seen by the streaming spectrum
+ * @return Frequency (Hz), -1 until SDFT_WINDOW_SIZE samples were fed at the
+ * current rate or if no peak clears SDFT_MIN_AMPLITUDE
+ * @note Only content below g_sampling_frequency/2 is visible, a peak close
+ * to it is handled by the rate controller alias guard
+ */
+float fft_streaming_max_frequency(void) {
+    return sdft_max_frequency(&g_spectrum, g_sampling_frequency);
+}
+
+/**
+ * @brief Adapt sampling rate from the streaming spectrum
+ * @return true if the rate was re-evaluated without an acquisition burst,
+ * false if the streaming spectrum has no estimate yet and the caller has to
+ * fall back to a full FFT acquisition
+ */
+bool fft_streaming_adjust_sampling_rate(void) {
+    const float max_freq = fft_streaming_max_frequency();
+    if (max_freq <= 0) {
+        return false;
+    }
+    fft_adjust_sampling_rate(max_freq);
+    return true;
 }
 
 /**
@@ -154,5 +243,5 @@ void fft_init(void) {
     Serial.printf("[FFT] Peak frequency: %.2f Hz\n", peak_freq);
 
     fft_adjust_sampling_rate(peak_freq);
-    Serial.printf("[FFT] Optimal sampling rate: %d Hz\n", g_sampling_frequency);
+    Serial.printf("[FFT] Optimal sampling rate: %d Hz (%s)\n", g_sampling_frequency, rate_reason_name(fft_last_rate_decision()->reason));
 }
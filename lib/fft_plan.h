@@ -0,0 +1,401 @@
+#pragma once
+#include <stdint.h>
+#include <math.h>
+#include "fixed_point.h"
+
+/*
+ * Compile-time real-input FFT plan
+ * FftPlan<N, W> transforms N real samples as N/2 interleaved complex values and
+ * splits the result into the N/2+1 unique bins of the real spectrum. Window,
+ * twiddle and bit-reversal tables are generated by the compiler and live in
+ * flash, so a run only costs the window multiply and the butterflies.
+ * FftPlanQ15<N, W, S> is the integer counterpart used when FFT_FIXED_POINT is set.
+ * fft_peak_offset() refines a peak found in either spectrum to a fraction of a bin.
+ * Written against C++11 constexpr rules (single-expression functions).
+ */
+
+// Window types
+enum fft_window_t {
+    FFT_WINDOW_RECTANGLE,
+    FFT_WINDOW_HAMMING,
+    FFT_WINDOW_HANN
+};
+
+namespace fft_detail {
+
+/* Constexpr Math ---------------------------------------------------------- */
+constexpr double CT_PI = 3.14159265358979323846;
+
+constexpr double ct_reduce(double x) {
+    return x > CT_PI ? ct_reduce(x - 2 * CT_PI) : (x < -CT_PI ? ct_reduce(x + 2 * CT_PI) : x);
+}
+
+constexpr double ct_sin_series(double x2, double term, int n, double acc) {
+    return n > 14 ? acc : ct_sin_series(x2, -term * x2 / ((2 * n) * (2 * n + 1)), n + 1, acc + term);
+}
+
+constexpr double ct_cos_series(double x2, double term, int n, double acc) {
+    return n > 14 ? acc : ct_cos_series(x2, -term * x2 / ((2 * n - 1) * (2 * n)), n + 1, acc + term);
+}
+
+constexpr double ct_sin_reduced(double x) { return ct_sin_series(x * x, x, 1, 0.0); }
+constexpr double ct_cos_reduced(double x) { return ct_cos_series(x * x, 1.0, 1, 0.0); }
+constexpr double ct_sin(double x) { return ct_sin_reduced(ct_reduce(x)); }
+constexpr double ct_cos(double x) { return ct_cos_reduced(ct_reduce(x)); }
+
+constexpr uint16_t ct_bit_reverse(uint16_t v, uint16_t bits, uint16_t acc) {
+    return bits == 0 ? acc : ct_bit_reverse(v >> 1, bits - 1, (uint16_t)((acc << 1) | (v & 1)));
+}
+
+constexpr uint16_t ct_log2(uint16_t n) { return n <= 1 ? 0 : 1 + ct_log2(n >> 1); }
+
+/* Index Sequence (log-depth, C++11) --------------------------------------- */
+template <uint16_t... I> struct index_seq {};
+
+template <typename A, typename B> struct seq_concat;
+template <uint16_t... A, uint16_t... B>
+struct seq_concat<index_seq<A...>, index_seq<B...> > {
+    typedef index_seq<A..., (uint16_t)(sizeof...(A) + B)...> type;
+};
+
+template <uint16_t N> struct make_index_seq {
+    typedef typename seq_concat<typename make_index_seq<N / 2>::type,
+                                typename make_index_seq<N - N / 2>::type>::type type;
+};
+template <> struct make_index_seq<0> { typedef index_seq<> type; };
+template <> struct make_index_seq<1> { typedef index_seq<0> type; };
+
+/* Table Generators -------------------------------------------------------- */
+// cos/sin of -2*pi*k/N for 0 <= k < N/2
+template <uint16_t N> struct twiddle_re_gen {
+    typedef float value_type;
+    static constexpr float at(uint16_t k) { return (float)ct_cos(-2 * CT_PI * k / N); }
+};
+template <uint16_t N> struct twiddle_im_gen {
+    typedef float value_type;
+    static constexpr float at(uint16_t k) { return (float)ct_sin(-2 * CT_PI * k / N); }
+};
+
+// Bit-reversed index for an M-point complex FFT
+template <uint16_t M> struct bit_reverse_gen {
+    typedef uint16_t value_type;
+    static constexpr uint16_t at(uint16_t k) { return ct_bit_reverse(k, ct_log2(M), 0); }
+};
+
+// First half of a symmetric window of length N
+template <uint16_t N, fft_window_t W> struct window_gen {
+    typedef float value_type;
+    static constexpr float at(uint16_t i) {
+        return W == FFT_WINDOW_HAMMING ? (float)(0.54 - 0.46 * ct_cos(2 * CT_PI * i / (N - 1)))
+             : W == FFT_WINDOW_HANN    ? (float)(0.5 - 0.5 * ct_cos(2 * CT_PI * i / (N - 1)))
+             : 1.0f;
+    }
+};
+
+// Q15 quantisation of another generator
+template <typename Gen> struct q15_gen {
+    typedef q15_t value_type;
+    static constexpr q15_t at(uint16_t k) { return q15_from_double(Gen::at(k)); }
+};
+
+template <typename Gen, typename Seq> struct ct_table;
+template <typename Gen, uint16_t... I>
+struct ct_table<Gen, index_seq<I...> > {
+    static constexpr typename Gen::value_type values[sizeof...(I)] = { Gen::at(I)... };
+};
+template <typename Gen, uint16_t... I>
+constexpr typename Gen::value_type ct_table<Gen, index_seq<I...> >::values[sizeof...(I)];
+
+} // namespace fft_detail
+
+/* FFT Plan ---------------------------------------------------------------- */
+/**
+ * @brief Real-input FFT with compile-time tables
+ * @tparam N Number of real samples (power of two, 4..32768)
+ * @tparam W Window applied by window()
+ */
+template <uint16_t N, fft_window_t W>
+class FftPlan {
+    static_assert(N >= 4 && (N & (N - 1)) == 0, "FFT size must be a power of two >= 4");
+
+    static const uint16_t M = N / 2;  // complex points
+
+    typedef fft_detail::ct_table<fft_detail::twiddle_re_gen<N>, typename fft_detail::make_index_seq<N / 2>::type> twiddle_re;
+    typedef fft_detail::ct_table<fft_detail::twiddle_im_gen<N>, typename fft_detail::make_index_seq<N / 2>::type> twiddle_im;
+    typedef fft_detail::ct_table<fft_detail::bit_reverse_gen<N / 2>, typename fft_detail::make_index_seq<N / 2>::type> bit_reverse;
+    typedef fft_detail::ct_table<fft_detail::window_gen<N, W>, typename fft_detail::make_index_seq<N / 2>::type> window_half;
+
+public:
+    static const uint16_t SIZE = N;
+    static const uint16_t BINS = N / 2 + 1;
+
+    /**
+     * @brief Apply the plan's window in place
+     * @param data Real sample buffer of N floats
+     */
+    static void window(float *data) {
+        for (uint16_t i = 0; i < M; i++) {
+            const float w = window_half::values[i];
+            data[i] *= w;
+            data[N - 1 - i] *= w;
+        }
+    }
+
+    /**
+     * @brief Forward FFT of N real samples, in place
+     * @param data Real input of N floats, overwritten with the packed spectrum
+     * @details Output layout: data[0] = X[0], data[1] = X[N/2] (both purely
+     * real), then (re, im) of X[k] at data[2k], data[2k+1] for 0 < k < N/2.
+     */
+    static void forward(float *data) {
+        complex_fft(data);
+
+        // DC and Nyquist bins come from the first complex point
+        const float z0_re = data[0];
+        const float z0_im = data[1];
+        data[0] = z0_re + z0_im;
+        data[1] = z0_re - z0_im;
+
+        // Split step: combine Z[k] and Z[M-k] into X[k] and X[M-k]
+        for (uint16_t k = 1; k <= (M >> 1); k++) {
+            const uint16_t a = 2 * k;
+            const uint16_t b = 2 * (M - k);
+            const float w_re = twiddle_re::values[k];
+            const float w_im = twiddle_im::values[k];
+
+            // Even part: (Z[k] + conj(Z[M-k])) / 2
+            const float fe_re = 0.5f * (data[a] + data[b]);
+            const float fe_im = 0.5f * (data[a + 1] - data[b + 1]);
+            // Odd part: -j * (Z[k] - conj(Z[M-k])) / 2
+            const float fo_re = 0.5f * (data[a + 1] + data[b + 1]);
+            const float fo_im = -0.5f * (data[a] - data[b]);
+
+            const float t_re = w_re * fo_re - w_im * fo_im;
+            const float t_im = w_re * fo_im + w_im * fo_re;
+
+            data[a] = fe_re + t_re;
+            data[a + 1] = fe_im + t_im;
+            // X[M-k] = conj(Fe - W^k * Fo)
+            data[b] = fe_re - t_re;
+            data[b + 1] = t_im - fe_im;
+        }
+    }
+
+    /**
+     * @brief Convert a packed spectrum into magnitudes, in place
+     * @param data Output of forward()
+     * @post data[k] holds |X[k]| for 0 <= k <= N/2
+     */
+    static void magnitude(float *data) {
+        const float dc = data[0];
+        const float nyquist = data[1];
+
+        // Ascending order never overwrites a bin that has not been read yet
+        for (uint16_t k = 1; k < M; k++) {
+            const float re = data[2 * k];
+            const float im = data[2 * k + 1];
+            data[k] = sqrtf(re * re + im * im);
+        }
+        data[0] = fabsf(dc);
+        data[M] = fabsf(nyquist);
+    }
+
+private:
+    /**
+     * @brief In-place radix-2 complex FFT over M interleaved (re, im) pairs
+     */
+    static void complex_fft(float *data) {
+        for (uint16_t i = 0; i < M; i++) {
+            const uint16_t j = bit_reverse::values[i];
+            if (i < j) {
+                float tr = data[2 * i];
+                float ti = data[2 * i + 1];
+                data[2 * i] = data[2 * j];
+                data[2 * i + 1] = data[2 * j + 1];
+                data[2 * j] = tr;
+                data[2 * j + 1] = ti;
+            }
+        }
+
+        // W_M^k == W_N^(2k): a stage of length len steps the table by N/len
+        for (uint16_t len = 2; len <= M; len <<= 1) {
+            const uint16_t half = len >> 1;
+            const uint16_t stride = N / len;
+            for (uint16_t k = 0; k < half; k++) {
+                const float w_re = twiddle_re::values[k * stride];
+                const float w_im = twiddle_im::values[k * stride];
+                for (uint16_t i = k; i < M; i += len) {
+                    const uint16_t a = 2 * i;
+                    const uint16_t b = 2 * (i + half);
+                    const float t_re = w_re * data[b] - w_im * data[b + 1];
+                    const float t_im = w_re * data[b + 1] + w_im * data[b];
+                    data[b] = data[a] - t_re;
+                    data[b + 1] = data[a + 1] - t_im;
+                    data[a] += t_re;
+                    data[a + 1] += t_im;
+                }
+            }
+        }
+    }
+};
+
+/* Q15 FFT Plan ------------------------------------------------------------ */
+/**
+ * @brief Fixed-point real-input FFT with compile-time Q15 tables
+ * @tparam N Number of real samples (power of two, 4..32768)
+ * @tparam W Window applied by window()
+ * @tparam S Left shift bringing input codes to full Q15 scale
+ * @details Every butterfly stage halves its outputs so nothing overflows;
+ * the packed spectrum and the magnitudes come out scaled by 1/N.
+ */
+template <uint16_t N, fft_window_t W, uint8_t S>
+class FftPlanQ15 {
+    static_assert(N >= 4 && (N & (N - 1)) == 0, "FFT size must be a power of two >= 4");
+
+    static const uint16_t M = N / 2;  // complex points
+
+    typedef typename fft_detail::make_index_seq<N / 2>::type index_t;
+    typedef fft_detail::ct_table<fft_detail::q15_gen<fft_detail::twiddle_re_gen<N> >, index_t> twiddle_re;
+    typedef fft_detail::ct_table<fft_detail::q15_gen<fft_detail::twiddle_im_gen<N> >, index_t> twiddle_im;
+    typedef fft_detail::ct_table<fft_detail::bit_reverse_gen<N / 2>, index_t> bit_reverse;
+    typedef fft_detail::ct_table<fft_detail::q15_gen<fft_detail::window_gen<N, W> >, index_t> window_half;
+
+public:
+    static const uint16_t SIZE = N;
+    static const uint16_t BINS = N / 2 + 1;
+
+    /**
+     * @brief Scale input codes to Q15 and apply the plan's window in place
+     * @param data Sample buffer of N codes
+     */
+    static void window(q15_t *data) {
+        for (uint16_t i = 0; i < M; i++) {
+            const q15_t w = window_half::values[i];
+            data[i] = q15_mul(q15_saturate((q31_t)data[i] << S), w);
+            data[N - 1 - i] = q15_mul(q15_saturate((q31_t)data[N - 1 - i] << S), w);
+        }
+    }
+
+    /**
+     * @brief Forward FFT of N Q15 samples, in place
+     * @param data Q15 input of N values, overwritten with the packed spectrum / N
+     * @details Same layout as FftPlan::forward()
+     */
+    static void forward(q15_t *data) {
+        complex_fft(data);
+
+        // Z is scaled by 1/M here, the split step adds the last 1/2
+        const q31_t z0_re = data[0];
+        const q31_t z0_im = data[1];
+        data[0] = (q15_t)((z0_re + z0_im) >> 1);
+        data[1] = (q15_t)((z0_re - z0_im) >> 1);
+
+        for (uint16_t k = 1; k <= (M >> 1); k++) {
+            const uint16_t a = 2 * k;
+            const uint16_t b = 2 * (M - k);
+            const q31_t w_re = twiddle_re::values[k];
+            const q31_t w_im = twiddle_im::values[k];
+
+            // Halves of the even and odd parts
+            const q31_t fe_re = ((q31_t)data[a] + data[b]) >> 2;
+            const q31_t fe_im = ((q31_t)data[a + 1] - data[b + 1]) >> 2;
+            const q31_t fo_re = ((q31_t)data[a + 1] + data[b + 1]) >> 2;
+            const q31_t fo_im = -(((q31_t)data[a] - data[b]) >> 2);
+
+            const q31_t t_re = (w_re * fo_re - w_im * fo_im) >> 15;
+            const q31_t t_im = (w_re * fo_im + w_im * fo_re) >> 15;
+
+            data[a] = q15_saturate(fe_re + t_re);
+            data[a + 1] = q15_saturate(fe_im + t_im);
+            data[b] = q15_saturate(fe_re - t_re);
+            data[b + 1] = q15_saturate(t_im - fe_im);
+        }
+    }
+
+    /**
+     * @brief Convert a packed spectrum into integer magnitudes, in place
+     * @param data Output of forward()
+     * @post data[k] holds |X[k]| / N for 0 <= k <= N/2
+     */
+    static void magnitude(q15_t *data) {
+        const q31_t dc = data[0];
+        const q31_t nyquist = data[1];
+
+        for (uint16_t k = 1; k < M; k++) {
+            const q31_t re = data[2 * k];
+            const q31_t im = data[2 * k + 1];
+            data[k] = q15_saturate(isqrt32((uint32_t)(re * re) + (uint32_t)(im * im)));
+        }
+        data[0] = q15_saturate(dc < 0 ? -dc : dc);
+        data[M] = q15_saturate(nyquist < 0 ? -nyquist : nyquist);
+    }
+
+private:
+    /**
+     * @brief In-place radix-2 complex FFT, each stage scaled by 1/2
+     */
+    static void complex_fft(q15_t *data) {
+        for (uint16_t i = 0; i < M; i++) {
+            const uint16_t j = bit_reverse::values[i];
+            if (i < j) {
+                q15_t tr = data[2 * i];
+                q15_t ti = data[2 * i + 1];
+                data[2 * i] = data[2 * j];
+                data[2 * i + 1] = data[2 * j + 1];
+                data[2 * j] = tr;
+                data[2 * j + 1] = ti;
+            }
+        }
+
+        for (uint16_t len = 2; len <= M; len <<= 1) {
+            const uint16_t half = len >> 1;
+            const uint16_t stride = N / len;
+            for (uint16_t k = 0; k < half; k++) {
+                const q31_t w_re = twiddle_re::values[k * stride];
+                const q31_t w_im = twiddle_im::values[k * stride];
+                for (uint16_t i = k; i < M; i += len) {
+                    const uint16_t a = 2 * i;
+                    const uint16_t b = 2 * (i + half);
+                    const q31_t t_re = (w_re * data[b] - w_im * data[b + 1]) >> 15;
+                    const q31_t t_im = (w_re * data[b + 1] + w_im * data[b]) >> 15;
+                    const q31_t a_re = data[a];
+                    const q31_t a_im = data[a + 1];
+                    data[b] = (q15_t)((a_re - t_re) >> 1);
+                    data[b + 1] = (q15_t)((a_im - t_im) >> 1);
+                    data[a] = (q15_t)((a_re + t_re) >> 1);
+                    data[a + 1] = (q15_t)((a_im + t_im) >> 1);
+                }
+            }
+        }
+    }
+};
+
+/* Peak Interpolation ------------------------------------------------------ */
+/**
+ * @brief Fractional offset of a spectral peak from its centre bin
+ * @param left Magnitude of the bin below the peak
+ * @param center Magnitude of the peak bin
+ * @param right Magnitude of the bin above the peak
+ * @return Offset in bins, within [-0.5, 0.5]
+ * @note Fits a parabola through the three magnitudes (PEAK_INTERP_QUADRATIC)
+ * or through their logarithms (PEAK_INTERP_GAUSSIAN, exact for a Gaussian
+ * main lobe and within a few hundredths of a bin for Hamming/Hann)
+ */
+static inline float fft_peak_offset(float left, float center, float right) {
+#if PEAK_INTERPOLATION == PEAK_INTERP_NONE
+    (void)left; (void)center; (void)right;
+    return 0.0f;
+#else
+#if PEAK_INTERPOLATION == PEAK_INTERP_GAUSSIAN
+    left = logf(fmaxf(left, 1e-6f));
+    center = logf(fmaxf(center, 1e-6f));
+    right = logf(fmaxf(right, 1e-6f));
+#endif
+    const float denom = left - 2.0f * center + right;
+    if (denom >= 0.0f) {
+        return 0.0f;  // Flat top, no curvature to fit
+    }
+    const float offset = 0.5f * (left - right) / denom;
+    return fmaxf(-0.5f, fminf(0.5f, offset));
+#endif
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <stdint.h>
+#include <math.h>
+#include "config.h"
+
+/*
+ * Fixed-point helpers and the sample type of the analysis pipeline.
+ * With FFT_FIXED_POINT set, samples are signed ADC codes of
+ * ADC_RESOLUTION_BITS bits (FIXED_SAMPLE_SCALE codes per signal unit) and the
+ * FFT, magnitudes and peak search run on integers.
+ */
+
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+
+#define Q15_MAX 32767
+#define Q15_MIN (-32768)
+#define FIXED_SAMPLE_MAX ((1 << (ADC_RESOLUTION_BITS - 1)) - 1)
+
+/* Q15 Arithmetic ---------------------------------------------------------- */
+/**
+ * @brief Clamp a 32-bit intermediate to the Q15 range
+ */
+static inline q15_t q15_saturate(q31_t v) {
+    return (q15_t)(v > Q15_MAX ? Q15_MAX : (v < Q15_MIN ? Q15_MIN : v));
+}
+
+/**
+ * @brief Rounded Q15 product
+ */
+static inline q15_t q15_mul(q15_t a, q15_t b) {
+    return q15_saturate(((q31_t)a * b + (1 << 14)) >> 15);
+}
+
+/**
+ * @brief Integer square root (bit-by-bit, no division)
+ * @param v Radicand
+ * @return floor(sqrt(v))
+ */
+static inline uint16_t isqrt32(uint32_t v) {
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+    while (bit > v) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (v >= root + bit) {
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint16_t)root;
+}
+
+/**
+ * @brief Quantise a real value in [-1, 1] to Q15 at compile time
+ */
+constexpr q15_t q15_from_double(double v) {
+    return v >= 32767.0 / 32768.0 ? (q15_t)Q15_MAX
+         : v <= -1.0              ? (q15_t)Q15_MIN
+         : (q15_t)(v * 32768.0 + (v >= 0 ? 0.5 : -0.5));
+}
+
+/* Pipeline Sample Type ---------------------------------------------------- */
+#if FFT_FIXED_POINT
+typedef int16_t fft_sample_t;  // Signed ADC code
+typedef int32_t sample_acc_t;  // Accumulator for sums of samples
+
+/**
+ * @brief Quantise a signal value to a signed ADC code
+ */
+static inline fft_sample_t sample_from_float(float v) {
+    const long code = lroundf(v * FIXED_SAMPLE_SCALE);
+    return (fft_sample_t)(code > FIXED_SAMPLE_MAX ? FIXED_SAMPLE_MAX : (code < -FIXED_SAMPLE_MAX ? -FIXED_SAMPLE_MAX : code));
+}
+
+/**
+ * @brief Convert an ADC code back to signal units
+ */
+static inline float sample_to_float(fft_sample_t v) {
+    return (float)v / FIXED_SAMPLE_SCALE;
+}
+
+/**
+ * @brief Convert a mean of ADC codes to signal units
+ */
+static inline float sample_level_to_float(float v) {
+    return v / FIXED_SAMPLE_SCALE;
+}
+#else
+typedef float fft_sample_t;
+typedef float sample_acc_t;
+
+static inline fft_sample_t sample_from_float(float v) { return v; }
+static inline float sample_to_float(fft_sample_t v) { return v; }
+static inline float sample_level_to_float(float v) { return v; }
+#endif
@@ -0,0 +1,72 @@
+#pragma once
+#include <stdint.h>
+#include "config.h"
+
+/*
+ * Spectrum noise floor
+ * Tones occupy a handful of bins, so the median bin magnitude follows the
+ * noise level of the spectrum whatever the sensor. A peak counts as a
+ * component when it clears the median by NOISE_SNR_MARGIN and sits within
+ * NOISE_DYNAMIC_RANGE of the strongest bin, the latter keeps the window
+ * sidelobes of a clean tone from being taken for components.
+ */
+
+/**
+ * @brief k-th smallest element (Hoare quickselect)
+ * @param data Values, reordered in place
+ * @param n Number of values
+ * @param k Rank, 0 <= k < n
+ * @return Value of rank k, O(n) on average
+ */
+template <typename T>
+T select_kth(T *data, int n, int k) {
+    int lo = 0;
+    int hi = n - 1;
+    while (lo < hi) {
+        const T pivot = data[lo + ((hi - lo) >> 1)];
+        int i = lo;
+        int j = hi;
+        while (i <= j) {
+            while (data[i] < pivot) i++;
+            while (data[j] > pivot) j--;
+            if (i <= j) {
+                const T tmp = data[i];
+                data[i++] = data[j];
+                data[j--] = tmp;
+            }
+        }
+        if (k <= j) {
+            hi = j;
+        } else if (k >= i) {
+            lo = i;
+        } else {
+            break;
+        }
+    }
+    return data[k];
+}
+
+/**
+ * @brief Detection threshold of a magnitude spectrum
+ * @param data FFT buffer of n entries holding magnitudes of bins 0..n/2
+ * @param n FFT size
+ * @return Magnitude a peak has to exceed
+ * @note Bins n/2+1..n-1 are free after the magnitude step and are used as
+ * scratch for the median, no extra RAM is needed
+ */
+template <typename T>
+float spectrum_noise_floor(T *data, uint16_t n) {
+    const uint16_t bins = (n >> 1) - 1;  // Bins 1..n/2-1, DC and Nyquist excluded
+    T *scratch = data + (n >> 1) + 1;
+    T peak = 0;
+    for (uint16_t i = 0; i < bins; i++) {
+        scratch[i] = data[i + 1];
+        if (scratch[i] > peak) {
+            peak = scratch[i];
+        }
+    }
+    const float median = (float)select_kth(scratch, bins, bins >> 1);
+    const float noise = NOISE_SNR_MARGIN * median;
+    const float sidelobe = NOISE_DYNAMIC_RANGE * (float)peak;
+    return noise > sidelobe ? noise : sidelobe;
+}
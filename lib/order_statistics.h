@@ -0,0 +1,230 @@
+#pragma once
+#include <stdint.h>
+#include <math.h>
+
+/*
+ * Order statistics over a bounded multiset
+ * Indexable skiplist: every link also stores how many elements it skips, so
+ * inserting, removing and reading the element of a given rank all take
+ * O(log n) steps. The nodes live in a fixed arena of N entries, nothing is
+ * allocated after construction.
+ */
+
+/**
+ * @brief Skiplist levels for n elements, 1 + ceil(log2(n))
+ */
+constexpr uint8_t order_statistics_levels(uint32_t n) {
+    return n <= 1 ? 1 : 1 + order_statistics_levels((n + 1) / 2);
+}
+
+template <uint16_t N>
+class OrderStatistics {
+    static_assert(N >= 1 && N < 0xFFFE, "OrderStatistics size out of range");
+    static constexpr uint8_t LEVELS = order_statistics_levels(N);
+    static constexpr uint16_t HEAD = N;      // Sentinel before the smallest element
+    static constexpr uint16_t TAIL = N + 1;  // Sentinel after the largest element, +inf
+
+public:
+    static constexpr uint16_t CAPACITY = N;
+
+    OrderStatistics() : seed_(0x9E3779B9UL) { clear(); }
+
+    /**
+     * @brief Remove every element
+     */
+    void clear() {
+        size_ = 0;
+        for (uint16_t i = 0; i < N; i++) {
+            free_[i] = N - 1 - i;
+        }
+        free_count_ = N;
+        nodes_[TAIL].value = INFINITY;
+        nodes_[TAIL].levels = LEVELS;
+        nodes_[HEAD].levels = LEVELS;
+        for (uint8_t l = 0; l < LEVELS; l++) {
+            nodes_[HEAD].next[l] = TAIL;
+            nodes_[HEAD].width[l] = 1;
+        }
+    }
+
+    uint16_t size() const { return size_; }
+
+    /**
+     * @brief Add an element
+     * @return false if all N nodes are in use
+     */
+    bool insert(float value) {
+        if (free_count_ == 0) {
+            return false;
+        }
+        uint16_t chain[LEVELS];
+        uint16_t steps_at[LEVELS];
+        uint16_t node = HEAD;
+        // Last node of every level that is not greater than value
+        for (int l = LEVELS - 1; l >= 0; l--) {
+            steps_at[l] = 0;
+            while (nodes_[nodes_[node].next[l]].value <= value) {
+                steps_at[l] += nodes_[node].width[l];
+                node = nodes_[node].next[l];
+            }
+            chain[l] = node;
+        }
+
+        const uint16_t fresh = free_[--free_count_];
+        Node &n = nodes_[fresh];
+        n.value = value;
+        n.levels = random_levels();
+        uint16_t steps = 0;
+        for (uint8_t l = 0; l < n.levels; l++) {
+            Node &prev = nodes_[chain[l]];
+            n.next[l] = prev.next[l];
+            prev.next[l] = fresh;
+            n.width[l] = prev.width[l] - steps;
+            prev.width[l] = steps + 1;
+            steps += steps_at[l];
+        }
+        for (uint8_t l = n.levels; l < LEVELS; l++) {
+            nodes_[chain[l]].width[l]++;
+        }
+        size_++;
+        return true;
+    }
+
+    /**
+     * @brief Remove one element equal to value
+     * @return false if there is none
+     */
+    bool erase(float value) {
+        uint16_t chain[LEVELS];
+        uint16_t node = HEAD;
+        // Last node of every level that is smaller than value
+        for (int l = LEVELS - 1; l >= 0; l--) {
+            while (nodes_[nodes_[node].next[l]].value < value) {
+                node = nodes_[node].next[l];
+            }
+            chain[l] = node;
+        }
+        const uint16_t victim = nodes_[chain[0]].next[0];
+        if (victim == TAIL || nodes_[victim].value != value) {
+            return false;
+        }
+
+        const Node &v = nodes_[victim];
+        for (uint8_t l = 0; l < v.levels; l++) {
+            Node &prev = nodes_[chain[l]];
+            prev.width[l] += v.width[l] - 1;
+            prev.next[l] = v.next[l];
+        }
+        for (uint8_t l = v.levels; l < LEVELS; l++) {
+            nodes_[chain[l]].width[l]--;
+        }
+        free_[free_count_++] = victim;
+        size_--;
+        return true;
+    }
+
+    /**
+     * @brief Element of a given rank
+     * @param rank 0 for the smallest, must be below size()
+     */
+    float at(uint16_t rank) const {
+        uint16_t node = HEAD;
+        uint32_t remaining = (uint32_t)rank + 1;
+        for (int l = LEVELS - 1; l >= 0; l--) {
+            while (nodes_[node].width[l] <= remaining) {
+                remaining -= nodes_[node].width[l];
+                node = nodes_[node].next[l];
+            }
+        }
+        return nodes_[node].value;
+    }
+
+    /**
+     * @brief Median, mean of the two middle elements for an even size
+     */
+    float median() const {
+        if (size_ == 0) {
+            return 0.0f;
+        }
+        const uint16_t half = size_ / 2;
+        return (size_ & 1) ? at(half) : 0.5f * (at(half - 1) + at(half));
+    }
+
+    /**
+     * @brief Median absolute deviation from the median
+     * @details The distances below and above the median form two sorted runs
+     * (ranks walked down and up from the middle), so their median is the k-th
+     * element of two sorted sequences, found by binary search on how many
+     * elements come from the lower run: O(log^2 n), no copy and no sort.
+     */
+    float mad() const { return mad(median()); }
+
+    /**
+     * @brief Median absolute deviation, median() already known
+     */
+    float mad(float m) const {
+        if (size_ == 0) {
+            return 0.0f;
+        }
+        const uint16_t half = size_ / 2;
+        return (size_ & 1) ? kth_distance(m, half, half)
+                           : 0.5f * (kth_distance(m, half, half - 1) + kth_distance(m, half, half));
+    }
+
+private:
+    struct Node {
+        float value;
+        uint8_t levels;
+        uint16_t next[LEVELS];
+        uint16_t width[LEVELS];  // Elements skipped by next[l], the target included
+    };
+
+    // Distance of the i-th element below the split, i = 0 is the closest
+    float lower_distance(float m, uint16_t split, uint16_t i) const { return m - at(split - 1 - i); }
+    // Distance of the j-th element from the split upwards
+    float upper_distance(float m, uint16_t split, uint16_t j) const { return at(split + j) - m; }
+
+    /**
+     * @brief k-th smallest |x - m|, 0-based
+     * @param m Median
+     * @param split Rank of the first element not below m
+     * @param k Rank among the distances
+     */
+    float kth_distance(float m, uint16_t split, uint16_t k) const {
+        const uint16_t lower = split;
+        const uint16_t upper = size_ - split;
+        // Smallest count a taken from the lower run with lower[a] >= upper[k - a]
+        uint16_t lo = (k + 1 > upper) ? k + 1 - upper : 0;
+        uint16_t hi = (k + 1 < lower) ? k + 1 : lower;
+        while (lo < hi) {
+            const uint16_t a = (lo + hi) / 2;
+            if (lower_distance(m, split, a) < upper_distance(m, split, k - a)) {
+                lo = a + 1;
+            } else {
+                hi = a;
+            }
+        }
+        const uint16_t a = lo;
+        const uint16_t b = k + 1 - a;
+        const float from_lower = a > 0 ? lower_distance(m, split, a - 1) : -INFINITY;
+        const float from_upper = b > 0 ? upper_distance(m, split, b - 1) : -INFINITY;
+        return from_lower > from_upper ? from_lower : from_upper;
+    }
+
+    /**
+     * @brief Geometric level count, P(levels > l) = 2^-l
+     */
+    uint8_t random_levels() {
+        // xorshift32
+        seed_ ^= seed_ << 13;
+        seed_ ^= seed_ >> 17;
+        seed_ ^= seed_ << 5;
+        return 1 + __builtin_ctz(seed_ | (1UL << (LEVELS - 1)));
+    }
+
+    Node nodes_[N + 2];
+    uint16_t free_[N];
+    uint16_t free_count_;
+    uint16_t size_;
+    uint32_t seed_;
+};
@@ -0,0 +1,116 @@
+#include "payload.h"
+#include <string.h>
+
+/* Little-endian fields ----------------------------------------------------- */
+static inline uint8_t *put_u16(uint8_t *p, uint16_t v) {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+    return p + 2;
+}
+
+static inline uint8_t *put_u32(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = v >> 24;
+    return p + 4;
+}
+
+static inline uint8_t *put_f32(uint8_t *p, float v) {
+    uint32_t bits;
+    memcpy(&bits, &v, 4);
+    return put_u32(p, bits);
+}
+
+static inline uint16_t get_u16(const uint8_t *p) {
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t get_u32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline float get_f32(const uint8_t *p) {
+    const uint32_t bits = get_u32(p);
+    float v;
+    memcpy(&v, &bits, 4);
+    return v;
+}
+
+/* Frames ------------------------------------------------------------------- */
+/**
+ * @brief Encode records into one frame
+ * @param buf Receives the frame
+ * @param size Bytes available, at least PAYLOAD_BYTES(count)
+ * @param first_id Id of records[0]
+ * @param time_ms Send time, echoed back by the edge
+ * @param records Records to send
+ * @param count Number of records
+ * @return Frame length, 0 if it does not fit
+ */
+uint16_t payload_encode(uint8_t *buf, uint16_t size, uint16_t first_id, uint32_t time_ms,
+                        const aggregate_record_t *records, uint8_t count) {
+    if (size < PAYLOAD_BYTES(count)) {
+        return 0;
+    }
+    uint8_t *p = buf;
+    *p++ = PAYLOAD_VERSION;
+    *p++ = count;
+    p = put_u16(p, first_id);
+    p = put_u32(p, time_ms);
+    for (uint8_t i = 0; i < count; i++) {
+        const aggregate_record_t *r = &records[i];
+        p = put_u32(p, r->count);
+        p = put_f32(p, r->mean);
+        p = put_f32(p, r->min);
+        p = put_f32(p, r->max);
+        p = put_f32(p, r->variance);
+        p = put_u32(p, r->first_us);
+        p = put_u32(p, r->last_us);
+    }
+    return p - buf;
+}
+
+/**
+ * @brief Restamp the send time of an encoded frame
+ * @param buf Frame
+ * @param time_ms Send time, for a frame published later than encoded
+ */
+void payload_set_time(uint8_t *buf, uint32_t time_ms) {
+    put_u32(&buf[4], time_ms);
+}
+
+/**
+ * @brief Decode a frame
+ * @param buf Frame
+ * @param len Frame length
+ * @param header Receives the header
+ * @param records Receives the first max_records records, may be NULL if 0
+ * @param max_records Room in records
+ * @return false if the frame is not of this version or its length does not
+ * match its record count
+ */
+bool payload_decode(const uint8_t *buf, uint16_t len, payload_header_t *header,
+                    aggregate_record_t *records, uint8_t max_records) {
+    if (len < PAYLOAD_HEADER_BYTES || buf[0] != PAYLOAD_VERSION ||
+        len != PAYLOAD_BYTES(buf[1])) {
+        return false;
+    }
+    header->version = buf[0];
+    header->count = buf[1];
+    header->first_id = get_u16(&buf[2]);
+    header->time_ms = get_u32(&buf[4]);
+
+    const uint8_t *p = &buf[PAYLOAD_HEADER_BYTES];
+    for (uint8_t i = 0; i < header->count && i < max_records; i++, p += PAYLOAD_RECORD_BYTES) {
+        aggregate_record_t *r = &records[i];
+        r->count = get_u32(p);
+        r->mean = get_f32(p + 4);
+        r->min = get_f32(p + 8);
+        r->max = get_f32(p + 12);
+        r->variance = get_f32(p + 16);
+        r->first_us = get_u32(p + 20);
+        r->last_us = get_u32(p + 24);
+    }
+    return true;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <stdint.h>
+#include "aggregate_record.h"
+
+/*
+ * Binary MQTT payload
+ * Aggregate records in a versioned little-endian frame instead of JSON
+ * text: an 8-byte header then 28 bytes per record, every field at full
+ * precision. The bytes are written one by one, so the frame reads the same
+ * on any host, and the decoder here builds there unchanged.
+ *
+ * Header: version (u8), record count (u8), id of the first record (u16),
+ *         send time in ms, echoed back for the RTT (u32)
+ * Record: count (u32), mean, min, max, variance (f32),
+ *         time of the first and last sample in µs (u32)
+ */
+
+#define PAYLOAD_VERSION 1
+#define PAYLOAD_HEADER_BYTES 8
+#define PAYLOAD_RECORD_BYTES 28
+#define PAYLOAD_BYTES(records) (PAYLOAD_HEADER_BYTES + (records) * PAYLOAD_RECORD_BYTES)
+
+typedef struct {
+    uint8_t version;
+    uint8_t count;       // Records in the frame
+    uint16_t first_id;   // Id of records[0], the next ones follow
+    uint32_t time_ms;    // Send time
+} payload_header_t;
+
+// Public API
+uint16_t payload_encode(uint8_t *buf, uint16_t size, uint16_t first_id, uint32_t time_ms,
+                        const aggregate_record_t *records, uint8_t count);
+bool payload_decode(const uint8_t *buf, uint16_t len, payload_header_t *header,
+                    aggregate_record_t *records, uint8_t max_records);
+void payload_set_time(uint8_t *buf, uint32_t time_ms);
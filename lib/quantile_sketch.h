@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+#include "config.h"
+#include "fixed_point.h"
+
+/*
+ * Streaming quantile sketch (KLL)
+ * Approximate percentiles of a stream in fixed memory. Items are kept in a
+ * stack of compactors: level h holds items that stand for 2^h samples. When
+ * the buffer is full the lowest level over its capacity is sorted and every
+ * other item, from a random offset, moves up one level, so inserting costs
+ * O(1) amortised. Capacities shrink by 2/3 per level below the top one
+ * (QUANTILE_SKETCH_K items), which keeps the rank error near 1/K whatever
+ * the length of the stream. Sketches of different windows or devices merge
+ * into one with the same guarantee, and the serialized form is compacted to
+ * a byte budget, small enough for a LoRa frame.
+ */
+
+#define QUANTILE_SKETCH_MIN_CAPACITY 8 // Smallest capacity of a level on the device
+#define QUANTILE_SKETCH_CAPACITY (3 * QUANTILE_SKETCH_K + QUANTILE_SKETCH_MIN_CAPACITY * QUANTILE_SKETCH_MAX_LEVELS)
+#define QUANTILE_SKETCH_VERSION 1 // First byte of the serialized form
+#define QUANTILE_SKETCH_HEADER_BYTES 14 // Serialized size without levels and items
+
+typedef struct {
+    float items[QUANTILE_SKETCH_CAPACITY];           // Levels from the top of the buffer down, free space first
+    uint16_t levels[QUANTILE_SKETCH_MAX_LEVELS + 1]; // Level h is items[levels[h]] to items[levels[h + 1] - 1]
+    uint8_t num_levels;
+    uint32_t count;                                  // Samples added
+    float min;                                       // Exact extremes
+    float max;
+    uint32_t seed;                                   // Compaction offsets
+} quantile_sketch_t;
+
+// Public API
+void quantile_sketch_init(quantile_sketch_t *s);
+void quantile_sketch_add(quantile_sketch_t *s, float value);
+void quantile_sketch_add_samples(quantile_sketch_t *s, const fft_sample_t *samples, uint16_t count);
+bool quantile_sketch_merge(quantile_sketch_t *s, const quantile_sketch_t *other);
+float quantile_sketch_quantile(quantile_sketch_t *s, float q);
+uint16_t quantile_sketch_serialize(quantile_sketch_t *s, uint8_t *buf, uint16_t max_bytes);
+bool quantile_sketch_deserialize(quantile_sketch_t *s, const uint8_t *buf, uint16_t len);
@@ -0,0 +1,132 @@
+#include "rate_controller.h"
+#include <math.h>
+#include <string.h>
+
+// Rates with a whole microsecond period (divisors of 1 MHz), ascending
+static const int RATE_TABLE[] = {
+    1, 2, 4, 5, 8, 10, 16, 20, 25, 32, 40, 50, 64, 80, 100, 125, 160, 200,
+    250, 320, 400, 500, 625, 800, 1000, 1250, 1600, 2000, 2500, 3125, 4000,
+    5000, 6250, 8000, 10000
+};
+#define RATE_TABLE_SIZE (sizeof(RATE_TABLE) / sizeof(RATE_TABLE[0]))
+
+/**
+ * @brief Smallest timer-friendly rate at or above a requested rate
+ * @param rate Requested rate (Hz)
+ * @return Rate from the table, clamped to [RATE_MIN, RATE_MAX]
+ */
+int rate_quantize_up(float rate) {
+    int quantized = RATE_MAX;
+    for (uint8_t i = 0; i < RATE_TABLE_SIZE; i++) {
+        if (RATE_TABLE[i] >= rate) {
+            quantized = RATE_TABLE[i];
+            break;
+        }
+    }
+    if (quantized < RATE_MIN) {
+        quantized = RATE_MIN;
+    }
+    return quantized > RATE_MAX ? RATE_MAX : quantized;
+}
+
+/**
+ * @brief Reset the controller, the next estimate is applied as a calibration
+ * @param ctl Controller state
+ */
+void rate_controller_init(rate_controller_t *ctl) {
+    memset(ctl, 0, sizeof(*ctl));
+}
+
+/**
+ * @brief Decide the sampling rate for a new max frequency estimate
+ * @param ctl Controller state
+ * @param current_rate Rate the estimate was taken at (Hz)
+ * @param max_freq Max frequency component (Hz), <= 0 if none was found
+ * @return Decision, its rate field is the rate to use from now on
+ * @details
+ * - Estimates differing from the previous one by more than
+ *   RATE_CHANGE_TOLERANCE go to RATE_MAX, the next estimate recalibrates
+ * - Peaks within RATE_ALIAS_FRACTION of Nyquist may be folded content, the
+ *   rate is raised by RATE_MAX_STEP_UP to look further
+ * - Estimates needing more than current_rate raise to the required rate
+ * - Estimates needing less than RATE_LOWER_RATIO * current_rate lower the
+ *   rate after RATE_LOWER_HOLD of them in a row, by RATE_MAX_STEP_DOWN at most
+ */
+rate_decision_t rate_controller_update(rate_controller_t *ctl, int current_rate, float max_freq) {
+    rate_decision_t d;
+    d.action = RATE_HOLD;
+    d.reason = RATE_REASON_NO_COMPONENT;
+    d.max_freq = max_freq;
+    d.previous_rate = current_rate;
+    d.required_rate = max_freq > 0 ? rate_quantize_up(NYQUIST_MULTIPLIER * max_freq) : current_rate;
+    d.rate = current_rate;
+
+    if (max_freq <= 0) {
+        ctl->last = d;
+        return d;
+    }
+
+    const bool changed = fabsf(max_freq - ctl->reference_freq) > RATE_CHANGE_TOLERANCE * ctl->reference_freq;
+    if (ctl->calibrated && changed && current_rate < RATE_MAX) {
+        d.reason = RATE_REASON_REGIME_CHANGE;
+        d.rate = RATE_MAX;
+    } else if (max_freq >= RATE_ALIAS_FRACTION * current_rate / 2 && current_rate < RATE_MAX) {
+        d.reason = RATE_REASON_ALIAS_GUARD;
+        d.rate = rate_quantize_up((float)current_rate * RATE_MAX_STEP_UP);
+    } else if (d.required_rate > current_rate) {
+        d.reason = RATE_REASON_UNDERSAMPLED;
+        const int ceiling = rate_quantize_up((float)current_rate * RATE_MAX_STEP_UP);
+        d.rate = d.required_rate < ceiling ? d.required_rate : ceiling;
+    } else if (d.required_rate < RATE_LOWER_RATIO * current_rate) {
+        if (!ctl->calibrated) {
+            d.reason = RATE_REASON_CALIBRATION;
+            d.rate = d.required_rate;
+        } else if (++ctl->lower_votes >= RATE_LOWER_HOLD) {
+            d.reason = RATE_REASON_OVERSAMPLED;
+            const int floor = rate_quantize_up((float)current_rate / RATE_MAX_STEP_DOWN);
+            d.rate = d.required_rate > floor ? d.required_rate : floor;
+        } else {
+            d.reason = RATE_REASON_HYSTERESIS;
+        }
+    } else {
+        d.reason = RATE_REASON_IN_BAND;
+    }
+
+    if (d.rate > current_rate) {
+        d.action = RATE_RAISE;
+    } else if (d.rate < current_rate) {
+        d.action = RATE_LOWER;
+    }
+    if (d.reason != RATE_REASON_HYSTERESIS) {
+        ctl->lower_votes = 0;
+    }
+    ctl->calibrated = (d.reason != RATE_REASON_REGIME_CHANGE);
+    ctl->reference_freq = max_freq;
+    ctl->last = d;
+    return d;
+}
+
+/**
+ * @brief Most recent decision
+ * @param ctl Controller state
+ */
+const rate_decision_t *rate_controller_last(const rate_controller_t *ctl) {
+    return &ctl->last;
+}
+
+/**
+ * @brief Printable name of a decision reason
+ */
+const char *rate_reason_name(rate_reason_t reason) {
+    switch (reason) {
+        case RATE_REASON_NO_COMPONENT: return "no component";
+        case RATE_REASON_IN_BAND:      return "in band";
+        case RATE_REASON_ALIAS_GUARD:  return "alias guard";
+        case RATE_REASON_REGIME_CHANGE: return "regime change";
+        case RATE_REASON_UNDERSAMPLED: return "undersampled";
+        case RATE_REASON_HYSTERESIS:   return "hysteresis";
+        case RATE_REASON_OVERSAMPLED:  return "oversampled";
+        case RATE_REASON_CALIBRATION:  return "calibration";
+    }
+    return "unknown";
+}
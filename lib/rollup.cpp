@@ -0,0 +1,131 @@
+#include "rollup.h"
+#include <string.h>
+
+/* Setup -------------------------------------------------------------------- */
+/**
+ * @brief Empty the store
+ * @param r Rollup state
+ * @return false if a period is zero or does not divide the next one
+ */
+bool rollup_init(rollup_t *r) {
+    memset(r, 0, sizeof(*r));
+    for (uint8_t level = 0; level < ROLLUP_LEVELS; level++) {
+        r->levels[level].period_us = ROLLUP_PERIODS[level] * 1000;
+        if (r->levels[level].period_us == 0) {
+            return false;
+        }
+        if (level > 0 && r->levels[level].period_us % r->levels[level - 1].period_us != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Stream ------------------------------------------------------------------- */
+/**
+ * @brief Close the buckets of a level that ended by now
+ * @param r Rollup state
+ * @param level Level to advance
+ * @param now_us Current time
+ * @return true if a bucket with samples was closed
+ * @details A closed bucket first lets the next level close the buckets that
+ * ended before it starts, then merges into the open one. Once the open
+ * bucket is empty a gap is crossed in one step.
+ */
+static bool rollup_level_advance(rollup_t *r, uint8_t level, uint32_t now_us) {
+    rollup_level_t *l = &r->levels[level];
+    bool closed = false;
+    while ((int32_t)(now_us - l->end_us) >= 0) {
+        if (l->open.count == 0) {
+            l->end_us += ((now_us - l->end_us) / l->period_us + 1) * l->period_us;
+            break;
+        }
+        l->buckets[l->next] = l->open;
+        l->next = (l->next + 1 == ROLLUP_CAPACITY) ? 0 : l->next + 1;
+        if (l->count < ROLLUP_CAPACITY) {
+            l->count++;
+        }
+        if (level + 1u < ROLLUP_LEVELS) {
+            rollup_level_advance(r, level + 1, l->end_us - l->period_us);
+            aggregate_record_merge(&r->levels[level + 1].open, &l->open);
+        }
+        aggregate_record_reset(&l->open);
+        l->end_us += l->period_us;
+        closed = true;
+    }
+    return closed;
+}
+
+/**
+ * @brief Close every bucket that ended by now
+ * @param r Rollup state
+ * @param now_us Current time, the time of the next sample
+ * @return true if a bucket of the finest level was closed
+ */
+bool rollup_advance(rollup_t *r, uint32_t now_us) {
+    if (!r->started) {
+        return false;
+    }
+    const bool closed = rollup_level_advance(r, 0, now_us);
+    for (uint8_t level = 1; level < ROLLUP_LEVELS; level++) {
+        rollup_level_advance(r, level, now_us);
+    }
+    return closed;
+}
+
+/**
+ * @brief Samples of a run that fall in the open bucket of the finest level
+ * @param r Rollup state
+ * @param time_us Time of the first sample of the run, after rollup_advance(r, time_us)
+ * @param period_us Time between samples
+ */
+uint16_t rollup_room(const rollup_t *r, uint32_t time_us, uint32_t period_us) {
+    const uint32_t left_us = r->started ? r->levels[0].end_us - time_us : r->levels[0].period_us;
+    const uint32_t room = (left_us + period_us - 1) / period_us;
+    return room > UINT16_MAX ? UINT16_MAX : (uint16_t)room;
+}
+
+/**
+ * @brief Add the record of a run of samples
+ * @param r Rollup state
+ * @param record Run of at most rollup_room() samples, starting after
+ * rollup_advance(r, record->first_us)
+ * @note The first run aligns the buckets of every level on its first sample
+ */
+void rollup_add(rollup_t *r, const aggregate_record_t *record) {
+    if (record->count == 0) {
+        return;
+    }
+    if (!r->started) {
+        r->started = true;
+        for (uint8_t level = 0; level < ROLLUP_LEVELS; level++) {
+            r->levels[level].end_us = record->first_us + r->levels[level].period_us;
+        }
+    }
+    aggregate_record_merge(&r->levels[0].open, record);
+}
+
+/* Queries ------------------------------------------------------------------ */
+/**
+ * @brief Last closed buckets of a level
+ * @param r Rollup state
+ * @param level 0 for the finest resolution
+ * @param out Receives the buckets, oldest first
+ * @param n Buckets wanted
+ * @return Buckets copied, at most n and the number stored
+ */
+uint16_t rollup_last(const rollup_t *r, uint8_t level, aggregate_record_t *out, uint16_t n) {
+    if (level >= ROLLUP_LEVELS) {
+        return 0;
+    }
+    const rollup_level_t *l = &r->levels[level];
+    if (n > l->count) {
+        n = l->count;
+    }
+    uint16_t slot = (l->next + ROLLUP_CAPACITY - n) % ROLLUP_CAPACITY;
+    for (uint16_t k = 0; k < n; k++) {
+        out[k] = l->buckets[slot];
+        slot = (slot + 1 == ROLLUP_CAPACITY) ? 0 : slot + 1;
+    }
+    return n;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <stdint.h>
+#include "config.h"
+#include "aggregate_record.h"
+
+/*
+ * Hierarchical rollups
+ * Aggregate records of the stream at ROLLUP_LEVELS resolutions (by default
+ * 1 s, 10 s and 1 min), each kept in a ring of the last ROLLUP_CAPACITY
+ * buckets. Samples go into the open bucket of the finest level; a closed
+ * bucket is stored and merged into the open bucket of the next level, so
+ * every level is built from the one below at no extra cost per sample.
+ * Memory is fixed however long the node runs: the oldest buckets are
+ * overwritten. Only buckets with samples are stored, each record carries
+ * the time of its first and last sample. Buckets are aligned on the first
+ * sample, every period must divide the next.
+ */
+
+static const uint32_t ROLLUP_PERIODS[] = ROLLUP_PERIODS_MS;
+#define ROLLUP_LEVELS (sizeof(ROLLUP_PERIODS) / sizeof(ROLLUP_PERIODS[0]))
+
+// One resolution
+typedef struct {
+    uint32_t period_us;
+    uint32_t end_us;                              // End of the open bucket
+    aggregate_record_t open;                      // Bucket being filled
+    aggregate_record_t buckets[ROLLUP_CAPACITY];  // Closed buckets, ring
+    uint16_t next;                                // Slot of the next closed bucket
+    uint16_t count;                               // Closed buckets stored
+} rollup_level_t;
+
+// Rollup store
+typedef struct {
+    rollup_level_t levels[ROLLUP_LEVELS];
+    bool started;
+} rollup_t;
+
+// Public API
+bool rollup_init(rollup_t *r);
+bool rollup_advance(rollup_t *r, uint32_t now_us);
+uint16_t rollup_room(const rollup_t *r, uint32_t time_us, uint32_t period_us);
+void rollup_add(rollup_t *r, const aggregate_record_t *record);
+uint16_t rollup_last(const rollup_t *r, uint8_t level, aggregate_record_t *out, uint16_t n);
@@ -0,0 +1,120 @@
+#include "sample_blocks.h"
+#include "spsc_ring.h"
+#include "sample_scheduler.h"
+
+/// @brief Static block pool
+static sample_block_t g_block_pool[SAMPLE_BLOCK_COUNT];
+
+/// @brief Empty blocks, released by the consumer and taken by the producer
+static SpscRing<sample_block_t *, SAMPLE_BLOCK_COUNT> g_free_blocks;
+
+/// @brief Filled blocks in stream order, submitted by the producer
+static SpscRing<sample_block_t *, SAMPLE_BLOCK_COUNT> g_filled_blocks;
+
+/**
+ * @brief Put every pool block on the free ring
+ * @return false if the pool was already handed out
+ * @note Both rings hold the whole pool, so submit and release never drop
+ */
+bool sample_blocks_init(void) {
+    if (g_free_blocks.size() != 0 || g_filled_blocks.size() != 0) {
+        return false;
+    }
+    for (uint8_t i = 0; i < SAMPLE_BLOCK_COUNT; i++) {
+        g_free_blocks.push(&g_block_pool[i]);
+    }
+    return true;
+}
+
+/**
+ * @brief Take an empty block from the pool (producer)
+ * @return Block owned by the caller, NULL if the pool is empty
+ * @note Never waits: the sampling task's notification belongs to the sample
+ * scheduler, so the free ring must not sleep on it
+ */
+sample_block_t *sample_block_acquire(void) {
+    sample_block_t *block = NULL;
+    if (!g_free_blocks.pop(&block)) {
+        return NULL;
+    }
+    block->count = 0;
+    return block;
+}
+
+/**
+ * @brief Hand a filled block over to the consumer (producer)
+ * @param block Block from sample_block_acquire(), no longer owned afterwards
+ */
+void sample_block_submit(sample_block_t *block) {
+    g_filled_blocks.push(block);
+}
+
+/**
+ * @brief Wait for the next filled block (consumer)
+ * @param wait Ticks to wait for one
+ * @return Block owned by the caller, NULL on timeout
+ */
+sample_block_t *sample_block_receive(TickType_t wait) {
+    sample_block_t *block = NULL;
+    if (!g_filled_blocks.pop_wait(&block, wait)) {
+        return NULL;
+    }
+    return block;
+}
+
+/**
+ * @brief Return a consumed block to the pool (consumer)
+ * @param block Block from sample_block_receive(), no longer owned afterwards
+ */
+void sample_block_release(sample_block_t *block) {
+    g_free_blocks.push(block);
+}
+
+/**
+ * @brief Append one sample, submitting the block when it is full
+ * @param writer Producer state
+ * @param sample Sample value
+ * @param sampling_frequency Rate the sample was taken at (Hz)
+ * @note Never blocks: with the pool exhausted the sample is counted in
+ * writer->dropped. A rate change submits the current block early.
+ */
+void sample_writer_push(sample_block_writer_t *writer, fft_sample_t sample, int sampling_frequency) {
+    if (writer->block != NULL && writer->block->sampling_frequency != sampling_frequency) {
+        sample_writer_flush(writer);
+    }
+    if (writer->block == NULL) {
+        writer->block = sample_block_acquire();
+        if (writer->block == NULL) {
+            writer->dropped++;
+            writer->index++;
+            writer->time_us += sample_period_us(sampling_frequency);
+            return;
+        }
+    }
+    if (writer->block->count == 0) {
+        writer->block->sampling_frequency = sampling_frequency;
+        writer->block->first_index = writer->index;
+        writer->block->first_time_us = writer->time_us;
+    }
+
+    writer->block->samples[writer->block->count++] = sample;
+    writer->index++;
+    writer->time_us += sample_period_us(sampling_frequency);
+    if (writer->block->count == SAMPLE_BLOCK_SIZE) {
+        sample_writer_flush(writer);
+    }
+}
+
+/**
+ * @brief Submit the block being filled, even if partial
+ * @param writer Producer state
+ * @note An empty block stays with the writer for the next sample, only the
+ * consumer pushes onto the free ring
+ */
+void sample_writer_flush(sample_block_writer_t *writer) {
+    if (writer->block == NULL || writer->block->count == 0) {
+        return;
+    }
+    sample_block_submit(writer->block);
+    writer->block = NULL;
+}
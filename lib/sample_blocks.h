@@ -0,0 +1,40 @@
+#pragma once
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "config.h"
+#include "fixed_point.h"
+
+/*
+ * Block sample transport
+ * The sampling task fills fixed-size blocks from a static pool and hands
+ * whole blocks to the aggregation task, only block pointers go through the
+ * lock-free rings (spsc_ring.h). One queue operation now covers SAMPLE_BLOCK_SIZE samples instead of
+ * one, at the price of up to SAMPLE_BLOCK_SIZE/rate seconds of latency.
+ * SAMPLE_BLOCK_COUNT must be a power of two.
+ */
+
+// A run of consecutive samples taken at one rate
+typedef struct {
+    uint16_t count;              // Valid samples
+    int sampling_frequency;      // Rate of every sample in the block (Hz)
+    uint32_t first_index;        // Stream index of samples[0]
+    uint32_t first_time_us;      // Nominal time of samples[0], one period apart after it
+    fft_sample_t samples[SAMPLE_BLOCK_SIZE];
+} sample_block_t;
+
+// Producer side state
+typedef struct {
+    sample_block_t *block;       // Block being filled, NULL if none
+    uint32_t index;              // Stream index of the next sample
+    uint32_t time_us;            // Nominal time of the next sample, advanced by its period
+    uint32_t dropped;            // Samples lost because the pool was empty
+} sample_block_writer_t;
+
+// Public API
+bool sample_blocks_init(void);
+sample_block_t *sample_block_acquire(void);
+void sample_block_submit(sample_block_t *block);
+sample_block_t *sample_block_receive(TickType_t wait);
+void sample_block_release(sample_block_t *block);
+void sample_writer_push(sample_block_writer_t *writer, fft_sample_t sample, int sampling_frequency);
+void sample_writer_flush(sample_block_writer_t *writer);
@@ -0,0 +1,31 @@
+#pragma once
+#include <stdint.h>
+#include "config.h"
+
+/*
+ * Sample history
+ * Ring of the last HISTORY_SIZE samples of the normal stream together with
+ * the time they were taken, so a re-analysis can start from what has already
+ * been sampled instead of a fresh oversampling burst. The spectrum is
+ * estimated with a Lomb-Scargle periodogram, which works on the timestamps
+ * and does not need evenly spaced samples.
+ * Content above the Nyquist frequency of the history folds back into its band
+ * and cannot be told apart. Unless the history was taken at the full rate, a
+ * re-analysis still needs a burst for the band above it, but the history
+ * resolves the band below, so that burst can be short.
+ */
+
+// Ring of timestamped samples
+typedef struct {
+    float value[HISTORY_SIZE];
+    uint32_t time_us[HISTORY_SIZE];  // Sampling time, wraps after ~71 minutes
+    uint16_t next;                   // Slot of the next sample, oldest once full
+    uint16_t count;
+} sample_history_t;
+
+// Public API
+void sample_history_reset(sample_history_t *history);
+void sample_history_push(sample_history_t *history, float value, uint32_t time_us);
+uint16_t sample_history_count(const sample_history_t *history);
+float sample_history_nyquist(const sample_history_t *history);
+float sample_history_max_frequency(const sample_history_t *history, float alias_fraction);
@@ -0,0 +1,103 @@
+#include "sample_scheduler.h"
+#include <string.h>
+
+/**
+ * @brief Timer callback, runs in the esp_timer task
+ * @param arg Scheduler state
+ */
+static void sample_scheduler_tick(void *arg) {
+    sample_scheduler_t *sched = (sample_scheduler_t *)arg;
+    xTaskNotifyGive(sched->task);
+}
+
+/**
+ * @brief Sampling period of a rate, rounded to the nearest microsecond
+ * @param sampling_frequency Rate in Hz
+ */
+uint32_t sample_period_us(int sampling_frequency) {
+    return (1000000UL + sampling_frequency / 2) / sampling_frequency;
+}
+
+/**
+ * @brief Start waking the calling task every sampling period
+ * @param sched Scheduler state
+ * @param sampling_frequency Rate in Hz
+ * @return false if the timer could not be created
+ * @note The first period ends one period after the call
+ */
+bool sample_scheduler_start(sample_scheduler_t *sched, int sampling_frequency) {
+    memset(sched, 0, sizeof(*sched));
+    sched->task = xTaskGetCurrentTaskHandle();
+    sched->period_us = sample_period_us(sampling_frequency);
+
+    const esp_timer_create_args_t args = {
+        .callback = sample_scheduler_tick,
+        .arg = sched,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "sampling",
+        .skip_unhandled_events = false
+    };
+    if (esp_timer_create(&args, &sched->timer) != ESP_OK) {
+        sched->timer = NULL;
+        return false;
+    }
+
+    // Drop a notification left over from a previous run
+    ulTaskNotifyTake(pdTRUE, 0);
+    esp_timer_start_periodic(sched->timer, sched->period_us);
+    return true;
+}
+
+/**
+ * @brief Follow a new sampling rate
+ * @param sched Scheduler state
+ * @param sampling_frequency Rate in Hz
+ * @note No-op if the period is unchanged, otherwise the timer restarts and the
+ * next deadline is one new period away
+ */
+void sample_scheduler_set_rate(sample_scheduler_t *sched, int sampling_frequency) {
+    const uint32_t period_us = sample_period_us(sampling_frequency);
+    if (sched->timer == NULL || period_us == sched->period_us) {
+        return;
+    }
+    sched->period_us = period_us;
+    esp_timer_stop(sched->timer);
+    esp_timer_start_periodic(sched->timer, period_us);
+}
+
+/**
+ * @brief Block until the next sampling deadline
+ * @param sched Scheduler state
+ * @return Periods elapsed since the previous call, more than 1 if the task
+ * overran its period (the extra ones are counted in missed)
+ * @note Falls back to a relative tick delay if the timer could not be created
+ */
+uint32_t sample_scheduler_wait(sample_scheduler_t *sched) {
+    if (sched->timer == NULL) {
+        vTaskDelay(pdMS_TO_TICKS(sched->period_us / 1000));
+        sched->ticks++;
+        return 1;
+    }
+    const uint32_t elapsed = ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    sched->ticks += elapsed;
+    if (elapsed > 1) {
+        sched->missed += elapsed - 1;
+    }
+    return elapsed;
+}
+
+/**
+ * @brief Stop and release the timer
+ * @param sched Scheduler state
+ * @note Call from the sampling task, the tick left in its notification slot
+ * is cleared so it cannot wake the task's next unrelated wait
+ */
+void sample_scheduler_stop(sample_scheduler_t *sched) {
+    if (sched->timer == NULL) {
+        return;
+    }
+    esp_timer_stop(sched->timer);
+    ulTaskNotifyTake(pdTRUE, 0);
+    esp_timer_delete(sched->timer);
+    sched->timer = NULL;
+}
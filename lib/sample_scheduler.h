@@ -0,0 +1,28 @@
+#pragma once
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+
+/*
+ * Sampling scheduler
+ * A periodic esp_timer keeps absolute deadlines with microsecond periods and
+ * wakes the sampling task through a task notification, so the loop body and
+ * tick rounding no longer stretch the sampling period.
+ */
+
+// Scheduler state, owned by the sampling task
+typedef struct {
+    esp_timer_handle_t timer;  // Periodic timer, NULL when stopped
+    TaskHandle_t task;         // Task woken on every period
+    uint32_t period_us;        // Current sampling period
+    uint32_t ticks;            // Periods elapsed since start
+    uint32_t missed;           // Periods that elapsed while the task was busy
+} sample_scheduler_t;
+
+// Public API
+bool sample_scheduler_start(sample_scheduler_t *sched, int sampling_frequency);
+void sample_scheduler_set_rate(sample_scheduler_t *sched, int sampling_frequency);
+uint32_t sample_scheduler_wait(sample_scheduler_t *sched);
+void sample_scheduler_stop(sample_scheduler_t *sched);
+uint32_t sample_period_us(int sampling_frequency);
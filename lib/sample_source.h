@@ -0,0 +1,97 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "config.h"
+#include "fixed_point.h"
+#include "signal_generator.h"
+#include "sample_scheduler.h"
+
+/*
+ * Sample sources
+ * Everything that produces samples for the pipeline is read through a
+ * sample_source_t: synthetic signals, a memory-mapped capture file on the
+ * host and the ADC on the device. A paced source delivers one sample per
+ * sampling period (sample_scheduler.h), an unpaced one as fast as it is read,
+ * which replays a capture faster than real time.
+ */
+
+// Signal type, same as in fft_analysis.h
+typedef float (*signal_function)(float t);
+
+typedef struct sample_source_t sample_source_t;
+
+// Implementation of a source
+typedef struct {
+    // Produce up to count samples, returns the number produced (0 = exhausted)
+    uint16_t (*read)(sample_source_t *src, fft_sample_t *out, uint16_t count);
+    // Called after src->sampling_frequency changed
+    void (*set_rate)(sample_source_t *src);
+    // Release the resources of the source, may be NULL
+    void (*close)(sample_source_t *src);
+} sample_source_ops_t;
+
+// Synthetic signal state
+typedef struct {
+    signal_function sig_func;
+    bool phasor;               // Generated by gen instead of sig_func
+    signal_generator_t gen;
+    double time;               // Time of the next sample when evaluating sig_func (s)
+} synthetic_source_t;
+
+// Capture file state (host)
+typedef struct {
+    const float *samples;
+    uint32_t num_samples;
+    uint32_t sampling_frequency;  // Rate of the capture (Hz)
+    double position;              // Next sample, in capture samples
+    double step;                  // Capture samples per output sample
+    void *map;
+    size_t map_size;
+} capture_source_t;
+
+// ADC state (device)
+typedef struct {
+    uint8_t pin;
+} adc_source_t;
+
+struct sample_source_t {
+    const sample_source_ops_t *ops;
+    const char *name;
+    int sampling_frequency;    // Output rate (Hz)
+    bool paced;                // Wait for the sampling deadline before each sample
+    bool started;              // Scheduler running, set by the first paced read
+    sample_scheduler_t sched;
+    uint32_t produced;         // Samples delivered so far
+    union {
+        synthetic_source_t synthetic;
+        capture_source_t capture;
+        adc_source_t adc;
+    };
+};
+
+/*
+ * Capture file layout, little-endian:
+ * sample_capture_header_t followed by num_samples float32 samples
+ */
+#define SAMPLE_CAPTURE_MAGIC 0x50414353UL  // "SCAP"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t sampling_frequency;  // Hz
+    uint32_t num_samples;
+    uint32_t reserved;
+} sample_capture_header_t;
+
+// Public API
+void sample_source_open_synthetic(sample_source_t *src, signal_function sig_func, const signal_desc_t *desc,
+                                  int sampling_frequency, uint32_t start_index, bool paced);
+#ifndef ARDUINO
+bool sample_source_open_capture(sample_source_t *src, const char *path, int sampling_frequency, bool paced);
+#endif
+#ifdef ARDUINO
+void sample_source_open_adc(sample_source_t *src, uint8_t pin, int sampling_frequency);
+#endif
+uint16_t sample_source_read(sample_source_t *src, fft_sample_t *out, uint16_t count);
+void sample_source_set_rate(sample_source_t *src, int sampling_frequency);
+void sample_source_pause(sample_source_t *src);
+void sample_source_close(sample_source_t *src);
@@ -1,16 +1,14 @@
 #include "shared_defs.h"
 #include <Arduino.h>
 #include "config.h"
+#include "fixed_point.h"
 
-QueueHandle_t xQueueSamples = NULL;
-QueueHandle_t xQueueAvgs = NULL;
+SpscRing<aggregate_record_t, AVG_RING_SIZE> g_avg_ring;
 TaskHandle_t xCommunicationTaskHandle = NULL;
 
 void init_shared_queues() {
-    xQueueSamples = xQueueCreate(QUEUE_SIZE, sizeof(float));
-    xQueueAvgs = xQueueCreate(QUEUE_SIZE, sizeof(float));
-    if(xQueueSamples ==  NULL || xQueueAvgs ==  NULL ) {
-        Serial.println("Queue creation failed!");
+    if(!sample_blocks_init()) {
+        Serial.println("Sample block pool init failed!");
         while(1); // Halt on critical failure
     }
 }
\ No newline at end of file
@@ -2,10 +2,12 @@
 #include <FreeRTOS.h>
 #include <queue.h>
 #include "config.h"
+#include "sample_blocks.h"
+#include "spsc_ring.h"
+#include "aggregate_record.h"
 
-// Shared queues for inter-task communication
-extern QueueHandle_t xQueueSamples;
-extern QueueHandle_t xQueueAvgs;
+// Shared streams for inter-task communication, samples travel in blocks (sample_blocks.h)
+extern SpscRing<aggregate_record_t, AVG_RING_SIZE> g_avg_ring;  // One record per closed window
 extern TaskHandle_t xCommunicationTaskHandle;
 
 // Initialization function
@@ -0,0 +1,47 @@
+#pragma once
+#include <stdint.h>
+#include "config.h"
+
+/*
+ * Phasor signal generator
+ * Synthetic signals are described as a sum of tones. Each tone is a complex
+ * phasor advanced by one fixed rotation per sample, so a sample costs one
+ * complex multiply per tone instead of a sin() call. Every
+ * SIGNAL_RESYNC_INTERVAL samples the phasors are recomputed from the sample
+ * index, which bounds the amplitude and phase drift of the float recursion.
+ */
+
+// One sine component: amplitude * sin(2*pi*frequency*t + phase)
+typedef struct {
+    float amplitude;
+    float frequency;  // Hz
+    float phase;      // rad
+} tone_t;
+
+// A synthetic signal
+typedef struct {
+    const tone_t *tones;
+    uint8_t num_tones;
+} signal_desc_t;
+
+// Generator state
+typedef struct {
+    tone_t tones[SIGNAL_MAX_TONES];
+    uint8_t num_tones;
+    int sampling_frequency;
+    double time_origin;         // Time of the last exact recomputation (s)
+    uint32_t index;             // Samples since time_origin
+    uint32_t next_resync;       // Index of the next exact recomputation
+    float re[SIGNAL_MAX_TONES];      // Phasors, amplitude * e^{j*angle}
+    float im[SIGNAL_MAX_TONES];
+    float rot_re[SIGNAL_MAX_TONES];  // Per-sample rotation e^{j*2*pi*f/fs}
+    float rot_im[SIGNAL_MAX_TONES];
+} signal_generator_t;
+
+// Public API
+void signal_generator_init(signal_generator_t *gen, const signal_desc_t *desc, int sampling_frequency);
+void signal_generator_set_rate(signal_generator_t *gen, int sampling_frequency);
+void signal_generator_seek(signal_generator_t *gen, double time);
+float signal_generator_next(signal_generator_t *gen);
+void signal_generator_block(signal_generator_t *gen, float *out, uint16_t count);
+double signal_generator_time(const signal_generator_t *gen);
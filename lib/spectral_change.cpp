@@ -0,0 +1,159 @@
+#include "spectral_change.h"
+#include <math.h>
+#include <string.h>
+
+/* CUSUM Test --------------------------------------------------------------- */
+static void cusum_reset(cusum_t *c) {
+    memset(c, 0, sizeof(*c));
+}
+
+/**
+ * @brief Add an observation
+ * @param c Test state
+ * @param x Observation
+ * @return true once the feature has moved away from its reference by more
+ * than CUSUM_SLACK spreads for long enough to accumulate CUSUM_THRESHOLD,
+ * in either direction
+ * @note The first SPECTRAL_LEARN_BLOCKS observations set the reference
+ */
+static bool cusum_update(cusum_t *c, float x) {
+    if (c->n < SPECTRAL_LEARN_BLOCKS) {
+        c->n++;
+        const float delta = x - c->mean;
+        c->mean += delta / c->n;
+        c->m2 += delta * (x - c->mean);
+        return false;
+    }
+    const float spread = sqrtf(c->m2 / c->n);
+    const float z = (x - c->mean) / (spread > SPECTRAL_MIN_SPREAD ? spread : SPECTRAL_MIN_SPREAD);
+    c->up = fmaxf(0.0f, c->up + z - CUSUM_SLACK);
+    c->down = fmaxf(0.0f, c->down - z - CUSUM_SLACK);
+    return c->up > CUSUM_THRESHOLD || c->down > CUSUM_THRESHOLD;
+}
+
+/* Detector ----------------------------------------------------------------- */
+/**
+ * @brief Clear the running block
+ * @param det Detector state
+ */
+static void spectral_change_start_block(spectral_change_t *det) {
+    for (uint8_t k = 0; k < SPECTRAL_BANDS; k++) {
+        det->s1[k] = 0.0f;
+        det->s2[k] = 0.0f;
+    }
+    det->block_sum = 0.0f;
+    det->energy = 0.0f;
+    det->prev = 0.0f;
+    det->crossings = 0;
+    det->count = 0;
+}
+
+/**
+ * @brief Set up the detector for a sampling rate
+ * @param det Detector state
+ * @param sampling_frequency Rate in Hz
+ * @note Band k sits at (k + 1) / (2 * (SPECTRAL_BANDS + 1)) of the rate, the
+ * bands are spread evenly between DC and Nyquist
+ */
+void spectral_change_init(spectral_change_t *det, int sampling_frequency) {
+    memset(det, 0, sizeof(*det));
+    det->sampling_frequency = sampling_frequency;
+    for (uint8_t k = 0; k < SPECTRAL_BANDS; k++) {
+        const float fraction = (float)(k + 1) / (2 * (SPECTRAL_BANDS + 1));
+        det->coeff[k] = 2.0f * cosf(2.0f * (float)M_PI * fraction);
+    }
+    spectral_change_reset(det);
+}
+
+/**
+ * @brief Forget the learnt spectrum, e.g. after a re-analysis
+ * @param det Detector state
+ */
+void spectral_change_reset(spectral_change_t *det) {
+    spectral_change_start_block(det);
+    det->blocks = 0;
+    for (uint8_t f = 0; f < SPECTRAL_FEATURES; f++) {
+        cusum_reset(&det->tests[f]);
+    }
+}
+
+/**
+ * @brief Follow a new sampling rate
+ * @param det Detector state
+ * @param sampling_frequency Rate in Hz
+ * @note No-op if the rate is unchanged, otherwise the detector starts over
+ */
+void spectral_change_set_rate(spectral_change_t *det, int sampling_frequency) {
+    if (sampling_frequency != det->sampling_frequency) {
+        spectral_change_init(det, sampling_frequency);
+    }
+}
+
+/**
+ * @brief Extract the features of a full block and run the tests
+ * @param det Detector state
+ * @return true if any feature changed
+ */
+static bool spectral_change_end_block(spectral_change_t *det) {
+    const uint16_t n = det->count;
+    float *features = det->features;
+
+    features[0] = (float)det->crossings / (n - 1);
+    for (uint8_t k = 0; k < SPECTRAL_BANDS; k++) {
+        // |X(f)|^2 relative to the block energy, about 1 for a pure tone on f
+        const float power = det->s1[k] * det->s1[k] + det->s2[k] * det->s2[k] - det->coeff[k] * det->s1[k] * det->s2[k];
+        features[1 + k] = det->energy > 0.0f ? power / (0.5f * n * det->energy) : 0.0f;
+    }
+    det->dc = det->block_sum / n;
+    det->blocks++;
+
+    bool changed = false;
+    for (uint8_t f = 0; f < SPECTRAL_FEATURES; f++) {
+        changed |= cusum_update(&det->tests[f], features[f]);
+    }
+    spectral_change_start_block(det);
+    return changed;
+}
+
+/**
+ * @brief Add a sample
+ * @param det Detector state
+ * @param sample New sample
+ * @return true when a block completes and its spectrum differs from the one
+ * learnt after the last reset; the caller re-analyses and resets
+ */
+bool spectral_change_update(spectral_change_t *det, float sample) {
+    // Median of the last three samples, isolated spikes never reach the features
+    const float a = det->history[0];
+    const float b = det->history[1];
+    det->history[0] = b;
+    det->history[1] = sample;
+    if (det->blocks == 0 && det->count < 2) {
+        // Prefilter not primed yet
+        det->history[0] = sample;
+    } else {
+        sample = fmaxf(fminf(a, b), fminf(fmaxf(a, b), sample));
+    }
+    if (det->blocks == 0 && det->count == 0) {
+        // No previous block yet, take the first sample as the DC estimate
+        det->dc = sample;
+    }
+    const float x = sample - det->dc;
+
+    if (det->count > 0 && ((x < 0.0f) != (det->prev < 0.0f))) {
+        det->crossings++;
+    }
+    det->prev = x;
+    det->block_sum += sample;
+    det->energy += x * x;
+    for (uint8_t k = 0; k < SPECTRAL_BANDS; k++) {
+        const float s = x + det->coeff[k] * det->s1[k] - det->s2[k];
+        det->s2[k] = det->s1[k];
+        det->s1[k] = s;
+    }
+
+    if (++det->count < SPECTRAL_BLOCK_SIZE) {
+        return false;
+    }
+    return spectral_change_end_block(det);
+}
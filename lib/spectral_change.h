@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+#include "config.h"
+
+/*
+ * Spectral change detector
+ * Decides when the frequency content of the stream has changed enough to
+ * justify a full FFT re-analysis. Every SPECTRAL_BLOCK_SIZE samples it
+ * extracts cheap features: the zero-crossing rate and the energy of
+ * SPECTRAL_BANDS Goertzel bands spread over the band up to Nyquist, each
+ * relative to the block energy so amplitude changes alone do not count.
+ * A median-of-3 prefilter keeps isolated spikes out of the features.
+ * The mean and spread of every feature are learnt over SPECTRAL_LEARN_BLOCKS
+ * blocks, then a two-sided CUSUM on the standardised feature flags a lasting
+ * shift of its mean. The features are relative to the sampling rate, so the
+ * detector starts over when the rate changes.
+ */
+
+#define SPECTRAL_FEATURES (1 + SPECTRAL_BANDS)
+
+// Two-sided CUSUM on one feature
+typedef struct {
+    uint16_t n;         // Observations learnt
+    float mean;         // Reference mean of the feature
+    float m2;           // Sum of squared deviations from the mean
+    float up;           // Cumulative standardised increase
+    float down;         // Cumulative standardised decrease
+} cusum_t;
+
+// Detector state
+typedef struct {
+    int sampling_frequency;
+    float coeff[SPECTRAL_BANDS];   // Goertzel 2*cos(w) of every band
+    float s1[SPECTRAL_BANDS];      // Goertzel state of the current block
+    float s2[SPECTRAL_BANDS];
+    float dc;                      // Mean of the previous block
+    float block_sum;
+    float energy;                  // Sum of squared deviations from dc
+    float prev;                    // Previous deviation from dc
+    float history[2];              // Last raw samples, median-of-3 prefilter
+    uint16_t crossings;
+    uint16_t count;                // Samples in the current block
+    uint32_t blocks;               // Blocks since reset
+    float features[SPECTRAL_FEATURES];  // Features of the last block
+    cusum_t tests[SPECTRAL_FEATURES];
+} spectral_change_t;
+
+// Public API
+void spectral_change_init(spectral_change_t *det, int sampling_frequency);
+void spectral_change_reset(spectral_change_t *det);
+void spectral_change_set_rate(spectral_change_t *det, int sampling_frequency);
+bool spectral_change_update(spectral_change_t *det, float sample);
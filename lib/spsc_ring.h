@@ -0,0 +1,113 @@
+#pragma once
+#include <stdint.h>
+#include <atomic>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/*
+ * Lock-free single-producer/single-consumer ring
+ * Producer and consumer each own one free-running index, so pushes and pops
+ * are plain loads and stores with acquire/release ordering and never enter a
+ * critical section. The indices sit on separate cache lines to keep the two
+ * cores from invalidating each other on every operation. A full ring drops
+ * the new item and counts it, the producer never waits. The consumer can
+ * block on its task notification until an item arrives.
+ */
+
+#ifndef SPSC_CACHE_LINE
+#define SPSC_CACHE_LINE 32  // ESP32 cache line, 64 on most hosts
+#endif
+
+template <typename T, uint16_t N>
+class SpscRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+
+public:
+    static constexpr uint16_t CAPACITY = N;
+
+    SpscRing() : head_(0), dropped_(0), tail_(0), waiter_(NULL) {}
+
+    /**
+     * @brief Append an item (producer only)
+     * @param item Item to copy in
+     * @return false if the ring was full, the item is dropped and counted
+     */
+    bool push(const T &item) {
+        const uint32_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) == N) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        items_[head & (N - 1)] = item;
+        head_.store(head + 1, std::memory_order_release);
+
+        // Pairs with the fence in pop_wait(), either side sees the other.
+        // Claiming the waiter wakes it once per sleep, not once per item.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiter_.load(std::memory_order_relaxed) != NULL) {
+            TaskHandle_t waiter = waiter_.exchange(NULL, std::memory_order_relaxed);
+            if (waiter != NULL) {
+                xTaskNotifyGive(waiter);
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief Take the oldest item (consumer only)
+     * @param item Destination
+     * @return false if the ring was empty
+     */
+    bool pop(T *item) {
+        const uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (head_.load(std::memory_order_acquire) == tail) {
+            return false;
+        }
+        *item = items_[tail & (N - 1)];
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Take the oldest item, sleeping on the task notification while empty
+     * @param item Destination
+     * @param wait Ticks to wait, portMAX_DELAY for ever
+     * @return false on timeout
+     * @note The consumer task must not use its notification value for anything
+     * else while waiting here
+     */
+    bool pop_wait(T *item, TickType_t wait) {
+        while (true) {
+            if (pop(item)) {
+                return true;
+            }
+            waiter_.store(xTaskGetCurrentTaskHandle(), std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (pop(item)) {
+                waiter_.store(NULL, std::memory_order_relaxed);
+                return true;
+            }
+            if (ulTaskNotifyTake(pdTRUE, wait) == 0 && wait != portMAX_DELAY) {
+                waiter_.store(NULL, std::memory_order_relaxed);
+                return pop(item);
+            }
+        }
+    }
+
+    /// @brief Items currently queued (approximate while the other side runs)
+    uint16_t size() const {
+        return (uint16_t)(head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire));
+    }
+
+    /// @brief Items dropped because the ring was full
+    uint32_t dropped() const {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+
+private:
+    alignas(SPSC_CACHE_LINE) std::atomic<uint32_t> head_;  // Written by the producer
+    std::atomic<uint32_t> dropped_;                        // Written by the producer
+    alignas(SPSC_CACHE_LINE) std::atomic<uint32_t> tail_;  // Written by the consumer
+    std::atomic<TaskHandle_t> waiter_;                     // Set by the consumer, claimed by the producer
+    alignas(SPSC_CACHE_LINE) T items_[N];
+};
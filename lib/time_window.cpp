@@ -0,0 +1,182 @@
+#include "time_window.h"
+#include <string.h>
+
+/**
+ * @brief Greatest common divisor
+ */
+static uint32_t time_window_gcd(uint32_t a, uint32_t b) {
+    while (b != 0) {
+        const uint32_t r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+/* Setup -------------------------------------------------------------------- */
+/**
+ * @brief Configure the windows
+ * @param w Engine state
+ * @param kind Tumbling, hopping or sliding
+ * @param size_ms Window length
+ * @param hop_ms Time between window starts, hopping only
+ * @return false if a length is zero or a window needs more than
+ * TIME_WINDOW_MAX_PANES - 1 panes
+ * @note A sliding window is rounded down to a multiple of
+ * TIME_WINDOW_SLIDING_PANES microseconds
+ */
+bool time_window_init(time_window_t *w, time_window_kind_t kind, uint32_t size_ms, uint32_t hop_ms) {
+    memset(w, 0, sizeof(*w));
+    const uint32_t size_us = size_ms * 1000;
+    uint32_t hop_us = hop_ms * 1000;
+    w->kind = kind;
+
+    switch (kind) {
+    case TIME_WINDOW_TUMBLING:
+        hop_us = size_us;
+        w->pane_us = size_us;
+        break;
+    case TIME_WINDOW_HOPPING:
+        w->pane_us = time_window_gcd(size_us, hop_us);
+        break;
+    case TIME_WINDOW_SLIDING:
+        w->pane_us = size_us / TIME_WINDOW_SLIDING_PANES;
+        hop_us = w->pane_us;
+        break;
+    }
+    if (size_us == 0 || hop_us == 0 || w->pane_us == 0) {
+        return false;
+    }
+    const uint32_t window_panes = size_us / w->pane_us;
+    if (window_panes + 1 > TIME_WINDOW_MAX_PANES) {
+        return false;
+    }
+    w->window_panes = window_panes;
+    w->hop_panes = hop_us / w->pane_us;
+    w->slots = window_panes + 1;
+    return true;
+}
+
+/**
+ * @brief Drop every pane, the next sample starts the windows again
+ * @param w Engine state
+ */
+void time_window_reset(time_window_t *w) {
+    memset(w->panes, 0, sizeof(w->panes));
+    w->head = 0;
+    w->panes_closed = 0;
+    w->pending = 0;
+    w->started = false;
+}
+
+/* Stream ------------------------------------------------------------------- */
+/**
+ * @brief Merge the panes of the window that ends with the last closed pane
+ * @param w Engine state
+ * @param end_us End of the last closed pane
+ * @param result Destination
+ */
+static void time_window_collect(const time_window_t *w, uint32_t end_us, time_window_result_t *result) {
+    // Oldest pane first, a merge appends the later run
+    uint16_t slot = (w->head + w->slots - w->window_panes) % w->slots;
+    aggregate_record_reset(&result->record);
+    for (uint16_t k = 0; k < w->window_panes; k++) {
+        aggregate_record_merge(&result->record, &w->panes[slot]);
+        slot = (slot + 1 == w->slots) ? 0 : slot + 1;
+    }
+    result->start_us = end_us - w->window_panes * w->pane_us;
+    result->end_us = end_us;
+}
+
+/**
+ * @brief Close the panes that ended by now
+ * @param w Engine state
+ * @param now_us Current time, the time of the next sample
+ * @param result Receives a window that closed
+ * @return true with one closed, non-empty window; call again until false
+ * before adding the sample at now_us
+ * @details Empty windows are skipped, and once every pane is empty a long
+ * gap (light sleep, a paused source) is crossed in one step.
+ */
+bool time_window_advance(time_window_t *w, uint32_t now_us, time_window_result_t *result) {
+    if (!w->started) {
+        return false;
+    }
+    while ((int32_t)(now_us - w->pane_end_us) >= 0) {
+        if (w->pending == 0) {
+            const uint32_t skipped = (now_us - w->pane_end_us) / w->pane_us;
+            w->panes_closed += skipped;
+            w->pane_end_us += skipped * w->pane_us;
+        }
+
+        // The slot after the head held the pane that just left the window
+        const uint32_t end_us = w->pane_end_us;
+        w->panes_closed++;
+        w->pane_end_us += w->pane_us;
+        w->head = (w->head + 1 == w->slots) ? 0 : w->head + 1;
+        w->pending -= w->panes[w->head].count;
+        aggregate_record_reset(&w->panes[w->head]);
+
+        if (w->panes_closed >= w->window_panes &&
+            (w->panes_closed - w->window_panes) % w->hop_panes == 0) {
+            time_window_collect(w, end_us, result);
+            if (result->record.count > 0) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Samples of a run that fall in the current pane
+ * @param w Engine state
+ * @param time_us Time of the first sample of the run, after time_window_advance(w, time_us)
+ * @param period_us Time between samples
+ * @return Samples from time_us on that time_window_add_record() may take as one run
+ */
+uint16_t time_window_room(const time_window_t *w, uint32_t time_us, uint32_t period_us) {
+    const uint32_t left_us = w->started ? w->pane_end_us - time_us : w->pane_us;
+    const uint32_t room = (left_us + period_us - 1) / period_us;
+    return room > UINT16_MAX ? UINT16_MAX : (uint16_t)room;
+}
+
+/**
+ * @brief Start the first pane on the first sample
+ * @param w Engine state
+ * @param time_us Time of the first sample
+ */
+static void time_window_start(time_window_t *w, uint32_t time_us) {
+    if (!w->started) {
+        w->started = true;
+        w->pane_end_us = time_us + w->pane_us;
+    }
+}
+
+/**
+ * @brief Add a sample to the current pane
+ * @param w Engine state
+ * @param value Sample
+ * @param time_us Time the sample was taken, after time_window_advance(w, time_us)
+ * @note The first sample starts the first pane
+ */
+void time_window_add(time_window_t *w, float value, uint32_t time_us) {
+    time_window_start(w, time_us);
+    aggregate_record_add(&w->panes[w->head], value, time_us);
+    w->pending++;
+}
+
+/**
+ * @brief Add the record of a run of samples to the current pane
+ * @param w Engine state
+ * @param record Run of at most time_window_room() samples, starting after
+ * time_window_advance(w, record->first_us)
+ */
+void time_window_add_record(time_window_t *w, const aggregate_record_t *record) {
+    if (record->count == 0) {
+        return;
+    }
+    time_window_start(w, record->first_us);
+    aggregate_record_merge(&w->panes[w->head], record);
+    w->pending += record->count;
+}
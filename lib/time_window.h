@@ -0,0 +1,55 @@
+#pragma once
+#include <stdint.h>
+#include "config.h"
+#include "aggregate_record.h"
+
+/*
+ * Time window engine
+ * Groups a timestamped sample stream into windows of TIME_WINDOW_SIZE_MS
+ * rather than a number of samples, so a window keeps its length in time when
+ * the sampling rate changes halfway through it.
+ * - Tumbling: back-to-back windows, one result per window
+ * - Hopping: windows of size starting every hop, overlapping if hop < size
+ * - Sliding: windows of size advanced every size / TIME_WINDOW_SLIDING_PANES
+ * Time is cut into panes of gcd(size, hop) that each keep an aggregate
+ * record, and a window is the merge of its last size / pane panes. Memory
+ * is TIME_WINDOW_MAX_PANES panes whatever the rate, and every sample is
+ * counted once, so the statistics weigh samples equally across a rate change.
+ * Windows start at the first sample; timestamps are wrap-safe uint32 µs.
+ */
+
+typedef enum {
+    TIME_WINDOW_TUMBLING,
+    TIME_WINDOW_HOPPING,
+    TIME_WINDOW_SLIDING
+} time_window_kind_t;
+
+// A closed window
+typedef struct {
+    uint32_t start_us;
+    uint32_t end_us;     // Exclusive
+    aggregate_record_t record;  // Samples in the window
+} time_window_result_t;
+
+// Engine state
+typedef struct {
+    time_window_kind_t kind;
+    uint32_t pane_us;               // Pane length
+    uint16_t window_panes;          // Panes per window
+    uint16_t hop_panes;             // Panes between window starts
+    aggregate_record_t panes[TIME_WINDOW_MAX_PANES];  // Ring, the current pane at head
+    uint16_t slots;                 // Ring length, a window and the current pane
+    uint16_t head;
+    uint32_t pane_end_us;           // End of the current pane
+    uint32_t panes_closed;          // Panes closed since the first sample
+    uint32_t pending;               // Samples in the panes of the ring
+    bool started;
+} time_window_t;
+
+// Public API
+bool time_window_init(time_window_t *w, time_window_kind_t kind, uint32_t size_ms, uint32_t hop_ms);
+void time_window_reset(time_window_t *w);
+bool time_window_advance(time_window_t *w, uint32_t now_us, time_window_result_t *result);
+uint16_t time_window_room(const time_window_t *w, uint32_t time_us, uint32_t period_us);
+void time_window_add(time_window_t *w, float value, uint32_t time_us);
+void time_window_add_record(time_window_t *w, const aggregate_record_t *record);
@@ -0,0 +1,232 @@
+#pragma once
+#include <stdint.h>
+#include "window_stats.h"
+
+/*
+ * Windowed aggregators
+ * Moving aggregates over the last N samples of a stream, all with the same
+ * interface (push, value, count, full, reset) so a stream picks one at
+ * compile time, e.g. AGGREGATE_WINDOW<float, WINDOW_SIZE> in config.h.
+ * Every push is O(1), amortised for the min/max deque:
+ * - WindowMean: running sum over a circular buffer
+ * - WindowMin / WindowMax: monotonic deque of the candidates for the extreme
+ * - WindowVariance: Welford's recurrence (window_stats.h)
+ * - Ewma: exponentially weighted mean with the span of an N-sample window
+ * A partly filled window aggregates the samples it holds.
+ */
+
+// Circular buffer of the last N samples
+template <typename T, uint16_t N>
+class WindowRing {
+    static_assert(N >= 1, "WindowRing needs a non-empty window");
+
+public:
+    static constexpr uint16_t CAPACITY = N;
+
+    WindowRing() { reset(); }
+
+    void reset() {
+        next_ = 0;
+        count_ = 0;
+    }
+
+    /**
+     * @brief Add a sample
+     * @param sample New sample
+     * @param evicted Receives the sample that left a full window
+     * @return true if a sample left the window
+     */
+    bool push(T sample, T *evicted) {
+        const bool was_full = (count_ == N);
+        if (was_full) {
+            *evicted = window_[next_];
+        } else {
+            count_++;
+        }
+        window_[next_] = sample;
+        next_ = (next_ + 1 == N) ? 0 : next_ + 1;
+        return was_full;
+    }
+
+    uint16_t count() const { return count_; }
+    bool full() const { return count_ == N; }
+
+private:
+    T window_[N];
+    uint16_t next_;
+    uint16_t count_;
+};
+
+/* Mean --------------------------------------------------------------------- */
+// Moving average from a running sum
+template <typename T, uint16_t N>
+class WindowMean {
+public:
+    static constexpr uint16_t CAPACITY = N;
+
+    WindowMean() { reset(); }
+
+    void reset() {
+        ring_.reset();
+        sum_ = 0.0f;
+        fresh_sum_ = 0.0f;
+        fresh_count_ = 0;
+    }
+
+    /**
+     * @brief Add a sample, the oldest one leaves a full window
+     * @note A second sum restarts every N samples and replaces the running one,
+     * so the float rounding of add-then-subtract does not build up
+     */
+    void push(T sample) {
+        T evicted = T();
+        sum_ += (float)sample;
+        if (ring_.push(sample, &evicted)) {
+            sum_ -= (float)evicted;
+        }
+        fresh_sum_ += (float)sample;
+        if (++fresh_count_ == N) {
+            sum_ = fresh_sum_;
+            fresh_sum_ = 0.0f;
+            fresh_count_ = 0;
+        }
+    }
+
+    /**
+     * @brief Mean of the samples in the window, 0 if empty
+     */
+    float value() const { return ring_.count() ? sum_ / ring_.count() : 0.0f; }
+
+    uint16_t count() const { return ring_.count(); }
+    bool full() const { return ring_.full(); }
+
+private:
+    WindowRing<T, N> ring_;
+    float sum_;
+    float fresh_sum_;
+    uint16_t fresh_count_;
+};
+
+/* Min / Max ---------------------------------------------------------------- */
+// Monotonic deque: samples that can still become the extreme, best first
+template <typename T, uint16_t N, typename Better>
+class WindowExtreme {
+    static_assert(N >= 1, "WindowExtreme needs a non-empty window");
+
+public:
+    static constexpr uint16_t CAPACITY = N;
+
+    WindowExtreme() { reset(); }
+
+    void reset() {
+        head_ = 0;
+        size_ = 0;
+        seen_ = 0;
+    }
+
+    /**
+     * @brief Add a sample, the oldest one leaves a full window
+     * @details Candidates no better than the new sample can never be the
+     * extreme again and are dropped from the back, the front drops once it
+     * leaves the window. Each sample enters and leaves once, O(1) amortised.
+     */
+    void push(T sample) {
+        if (size_ > 0 && seen_ - index_[head_] >= N) {
+            head_ = (head_ + 1 == N) ? 0 : head_ + 1;
+            size_--;
+        }
+        while (size_ > 0 && !Better()(values_[back()], sample)) {
+            size_--;
+        }
+        const uint16_t slot = wrap(head_ + size_);
+        values_[slot] = sample;
+        index_[slot] = seen_;
+        size_++;
+        seen_++;
+    }
+
+    /**
+     * @brief Extreme of the samples in the window, valid once count() > 0
+     */
+    float value() const { return size_ ? (float)values_[head_] : 0.0f; }
+
+    uint16_t count() const { return seen_ < N ? (uint16_t)seen_ : N; }
+    bool full() const { return seen_ >= N; }
+
+private:
+    static uint16_t wrap(uint16_t i) { return i >= N ? i - N : i; }
+    uint16_t back() const { return wrap(head_ + size_ - 1); }
+
+    T values_[N];
+    uint32_t index_[N];  // Stream position of every candidate
+    uint16_t head_;
+    uint16_t size_;
+    uint32_t seen_;      // Samples pushed since reset
+};
+
+template <typename T>
+struct WindowLess {
+    bool operator()(T a, T b) const { return a < b; }
+};
+
+template <typename T>
+struct WindowGreater {
+    bool operator()(T a, T b) const { return a > b; }
+};
+
+template <typename T, uint16_t N>
+class WindowMin : public WindowExtreme<T, N, WindowLess<T> > {};
+
+template <typename T, uint16_t N>
+class WindowMax : public WindowExtreme<T, N, WindowGreater<T> > {};
+
+/* Variance ----------------------------------------------------------------- */
+// Population variance of the window
+template <typename T, uint16_t N>
+class WindowVariance : public WindowStats<T, N> {
+public:
+    float value() const { return WindowStats<T, N>::variance(); }
+};
+
+/* EWMA --------------------------------------------------------------------- */
+// Exponentially weighted mean, alpha = 2 / (N + 1) gives the centre of mass of an N-sample window
+template <typename T, uint16_t N>
+class Ewma {
+public:
+    static constexpr uint16_t CAPACITY = N;
+
+    Ewma() { reset(); }
+
+    void reset() {
+        value_ = 0.0f;
+        count_ = 0;
+    }
+
+    /**
+     * @brief Add a sample, the first one sets the mean
+     */
+    void push(T sample) {
+        const float x = (float)sample;
+        if (count_ == 0) {
+            value_ = x;
+        } else {
+            value_ += (2.0f / (N + 1)) * (x - value_);
+        }
+        if (count_ < N) {
+            count_++;
+        }
+    }
+
+    float value() const { return value_; }
+
+    uint16_t count() const { return count_; }
+
+    /**
+     * @brief true once N samples have been seen, earlier the first one still dominates
+     */
+    bool full() const { return count_ == N; }
+
+private:
+    float value_;
+    uint16_t count_;
+};
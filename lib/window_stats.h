@@ -0,0 +1,103 @@
+#pragma once
+#include <stdint.h>
+#include <math.h>
+
+/*
+ * Sliding window statistics
+ * Mean and variance of the last N samples, updated in O(1) per sample with
+ * Welford's recurrence: a new sample replaces the oldest one in the running
+ * mean and sum of squared deviations. A second accumulator restarts every N
+ * samples and, once it has seen a whole window, replaces the running state,
+ * so float rounding never builds up over long runs and no sample ever pays
+ * for a full pass over the window.
+ */
+
+template <typename T, uint16_t N>
+class WindowStats {
+    static_assert(N >= 1, "WindowStats needs a non-empty window");
+
+public:
+    static constexpr uint16_t CAPACITY = N;
+
+    WindowStats() { reset(); }
+
+    /**
+     * @brief Forget every sample
+     */
+    void reset() {
+        next_ = 0;
+        count_ = 0;
+        mean_ = 0.0f;
+        m2_ = 0.0f;
+        fresh_count_ = 0;
+        fresh_mean_ = 0.0f;
+        fresh_m2_ = 0.0f;
+    }
+
+    /**
+     * @brief Add a sample, the oldest one leaves a full window
+     * @param sample New sample
+     */
+    void push(T sample) {
+        const float x = (float)sample;
+        if (count_ == N) {
+            const float old = (float)window_[next_];
+            const float delta = x - old;
+            const float mean = mean_ + delta * (1.0f / N);
+            m2_ += delta * (x - mean + old - mean_);
+            mean_ = mean;
+        } else {
+            count_++;
+            const float delta = x - mean_;
+            mean_ += delta / count_;
+            m2_ += delta * (x - mean_);
+        }
+        window_[next_] = sample;
+        next_ = (next_ + 1 == N) ? 0 : next_ + 1;
+
+        // Fresh accumulator over the samples since the last refresh
+        fresh_count_++;
+        const float delta = x - fresh_mean_;
+        fresh_mean_ += delta / fresh_count_;
+        fresh_m2_ += delta * (x - fresh_mean_);
+        if (fresh_count_ == N) {
+            mean_ = fresh_mean_;
+            m2_ = fresh_m2_;
+            fresh_count_ = 0;
+            fresh_mean_ = 0.0f;
+            fresh_m2_ = 0.0f;
+        }
+    }
+
+    uint16_t count() const { return count_; }
+    bool full() const { return count_ == N; }
+
+    /**
+     * @brief Mean of the samples in the window, 0 if empty
+     */
+    float mean() const { return mean_; }
+
+    /**
+     * @brief Population variance of the samples in the window
+     */
+    float variance() const {
+        return (count_ == 0 || m2_ <= 0.0f) ? 0.0f : m2_ / count_;
+    }
+
+    float stddev() const { return sqrtf(variance()); }
+
+    /**
+     * @brief Sample that the next push replaces, valid once full
+     */
+    T oldest() const { return window_[next_]; }
+
+private:
+    T window_[N];
+    uint16_t next_;
+    uint16_t count_;
+    float mean_;
+    float m2_;  // Sum of squared deviations from the mean
+    uint16_t fresh_count_;
+    float fresh_mean_;
+    float fresh_m2_;
+};
@@ -9,7 +9,35 @@
 #define SUBSCRIBE_TOPIC "luca/esp32/acks"
 
 #define INIT_SAMPLE_RATE 1000 // Hz
+#define NYQUIST_MULTIPLIER 2.5f // Sampling rate / max frequency
+#define RATE_MIN 1 // Hz
+#define RATE_MAX INIT_SAMPLE_RATE // Hz
+#define RATE_LOWER_RATIO 0.8f // Lower only if the required rate is below this fraction of the current one
+#define RATE_LOWER_HOLD 2 // Consecutive estimates needed to lower the rate
+#define RATE_MAX_STEP_UP 4 // Largest raise factor per decision
+#define RATE_MAX_STEP_DOWN 4 // Largest lowering factor per decision
+#define RATE_ALIAS_FRACTION 0.9f // Peaks above this fraction of Nyquist may be aliased
+#define RATE_CHANGE_TOLERANCE 0.1f // Relative estimate change treated as a new regime
 #define NUM_SAMPLES 1024
+#define NOISE_SNR_MARGIN 5.0f // Peak to median bin magnitude ratio for a component
+#define NOISE_DYNAMIC_RANGE 0.01f // Weakest component relative to the strongest bin (-40 dB)
+#define FFT_WINDOW_TYPE FFT_WINDOW_HAMMING
+#define SDFT_WINDOW_SIZE 64 // Streaming spectrum length (power of two)
+#define SDFT_MIN_AMPLITUDE 0.5f // Peak amplitude floor of the streaming spectrum
+#define SPECTRAL_BLOCK_SIZE 32 // Samples per feature vector of the change detector
+#define SPECTRAL_BANDS 4 // Goertzel bands of the change detector, spread up to Nyquist
+#define SPECTRAL_LEARN_BLOCKS 16 // Blocks that set the reference spectrum after a reset
+#define SPECTRAL_MIN_SPREAD 0.02f // Floor of the learnt feature spread
+#define CUSUM_SLACK 1.0f // Tolerated feature shift, in learnt spreads per block
+#define CUSUM_THRESHOLD 8.0f // Accumulated shift that signals a change, in spreads
+#define HISTORY_SIZE 128 // Timestamped samples kept, a re-analysis waits for this many of the new spectrum
+#define HISTORY_MIN_SAMPLES 64 // Fewer samples leave the history inconclusive
+#define HISTORY_OVERSAMPLING 4 // Periodogram frequencies per 1/span of the history
+#define HISTORY_SNR_MARGIN 10.0f // Peak to median periodogram power ratio for a component
+#define HISTORY_DYNAMIC_RANGE 0.002f // Weakest peak power relative to the strongest (-27 dB)
+#define HISTORY_MIN_CYCLES 2 // Cycles over the history span needed to trust a peak
+#define HISTORY_BURST_CYCLES 8 // Burst cycles at the top of the history band, sets the burst length
+#define HISTORY_MIN_BURST 64 // Shortest burst above the history band (power of two)
 #define QUEUE_SIZE NUM_OF_SAMPLES_AGGREGATE
 
 #define NUM_OF_SAMPLES_AGGREGATE 20
@@ -1,7 +1,6 @@
 #include <cmath>
 #include "fft_analysis_minimal.h"
 #include <Arduino.h>
-#include <arduinoFFT.h>
 #include <math.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -9,18 +8,27 @@
 #include "esp_sleep.h"
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "fft_plan.h"
+#include "sliding_dft.h"
 
 #define NOISE_THRESHOLD  8
 
-/// @brief Real component buffer for FFT input
+/// @brief Real sample buffer for FFT input, holds magnitudes after analysis
 float g_samples_real[NUM_SAMPLES] = {0};
 
-/// @brief Imaginary component buffer for FFT input
-float g_samples_imag[NUM_SAMPLES] = {0};
-
 /// @brief Current system sampling frequency (Hz)
 int g_sampling_frequency = INIT_SAMPLE_RATE;
 
+/// @brief FFT plan with compile-time window and twiddle tables
+typedef FftPlan<NUM_SAMPLES, FFT_WINDOW_TYPE> fft_plan_t;
+
+/// @brief Streaming spectrum of the normal sample stream
+static sliding_dft_t g_spectrum;
+
+/// @brief Decides rate changes from max frequency estimates, the first one calibrates it
+static rate_controller_t g_rate_controller;
+
+
 /* Signal Generation ------------------------------------------------------- */
 /**
  * @brief Generate signal containing 3Hz and 5Hz sine wave components
@@ -61,11 +69,13 @@ float sample_signal(signal_function sig_func, int index, int sample_rate) {
  * @brief Perform signal acquisition for FFT processing
  * @param sig_func Signal generation function pointer
  * @param num_samples Number of samples to acquire
+ * @note Entries from num_samples on are zeroed, a short burst comes out zero-padded
  */
 void fft_process_signal(signal_function sig_func,int num_samples) {
-    for( int i= 0; i< num_samples;i++){
+    // The burst interrupts the normal stream
+    sdft_reset(&g_spectrum);
+    for (int i = num_samples; i < NUM_SAMPLES; i++) {
         g_samples_real[i] = 0;
-        g_samples_imag[i] = 0;
     }
     for (int i = 0; i < num_samples; i++) {
         g_samples_real[i] = sample_signal(sig_func, i, g_sampling_frequency);
@@ -80,21 +90,40 @@ void fft_process_signal(signal_function sig_func,int num_samples) {
 /**
  * @brief Execute complete FFT processing chain
  * @details Performs:
- * 1. Hamming window application
- * 2. Forward FFT computation
+ * 1. Window application (FFT_WINDOW_TYPE)
+ * 2. Forward real-input FFT computation
  * 3. Complex-to-magnitude conversion
  * 4. Calc max frequency
- * @note Results stored in module buffers
+ * @note Tables are precomputed in flash, only the butterflies run here
+ * @note Magnitudes of bins 0..NUM_SAMPLES/2 stored in g_samples_real
  */
 float fft_perform_analysis(void) {
-    ArduinoFFT<float> FFT = ArduinoFFT<float>(
-    g_samples_real, 
-    g_samples_imag, 
-    NUM_SAMPLES, 
-    g_sampling_frequency);
-    FFT.windowing(FFT_WIN_TYP_HAMMING, FFT_FORWARD);
-    FFT.compute(FFT_FORWARD);
-    FFT.complexToMagnitude();
+    fft_plan_t::window(g_samples_real);
+    fft_plan_t::forward(g_samples_real);
+    fft_plan_t::magnitude(g_samples_real);
+    return fft_get_max_frequency();
+}
+
+/**
+ * @brief FFT of a short burst zero-padded to NUM_SAMPLES
+ * @param num_samples Samples acquired by fft_process_signal(), up to NUM_SAMPLES
+ * @details The window (FFT_WINDOW_TYPE) spans the acquired samples only and
+ * is computed here, the padding interpolates their spectrum onto the
+ * NUM_SAMPLES bin grid so the usual peak search applies. Resolution stays
+ * that of the short burst.
+ */
+float fft_perform_burst_analysis(int num_samples) {
+    if (num_samples >= NUM_SAMPLES) {
+        return fft_perform_analysis();
+    }
+    for (int i = 0; i < num_samples; i++) {
+        const float c = cosf(2 * PI * i / (num_samples - 1));
+        g_samples_real[i] *= FFT_WINDOW_TYPE == FFT_WINDOW_HAMMING ? 0.54f - 0.46f * c
+                           : FFT_WINDOW_TYPE == FFT_WINDOW_HANN    ? 0.5f - 0.5f * c
+                           : 1.0f;
+    }
+    fft_plan_t::forward(g_samples_real);
+    fft_plan_t::magnitude(g_samples_real);
     return fft_get_max_frequency();
 }
 
@@ -124,9 +153,75 @@ float fft_get_max_frequency(void) {
 /**
  * @brief Adapt sampling rate based on Nyquist-Shannon criteria
  * @param max_freq Max detected frequency component
- * @note Implements safety factor of 2.5× maximum frequency
+ * @note Implements safety factor of NYQUIST_MULTIPLIER × maximum frequency,
+ * raising and lowering through the rate controller (rate_controller.h)
+ * @note Keeps the current rate if no component was found (max_freq <= 0)
  */
 void fft_adjust_sampling_rate(float max_freq) {
-  int new_rate = (int)(NYQUIST_MULTIPLIER * max_freq);
-  g_sampling_frequency = (g_sampling_frequency > new_rate) ? new_rate : g_sampling_frequency;
+    const rate_decision_t decision = rate_controller_update(&g_rate_controller, g_sampling_frequency, max_freq);
+    g_sampling_frequency = decision.rate;
+
+    // Streaming bins are spaced by the sampling rate, start over on change
+    if (decision.action != RATE_HOLD) {
+        sdft_reset(&g_spectrum);
+    }
+}
+
+/**
+ * @brief Go back to INIT_SAMPLE_RATE before a full-band estimate
+ * @note The next fft_adjust_sampling_rate() recalibrates the controller,
+ * without slew limit or hysteresis
+ */
+void fft_recalibrate_sampling_rate(void) {
+    if (g_sampling_frequency != INIT_SAMPLE_RATE) {
+        sdft_reset(&g_spectrum);
+    }
+    g_sampling_frequency = INIT_SAMPLE_RATE;
+    rate_controller_init(&g_rate_controller);
+}
+
+/**
+ * @brief Last decision taken by fft_adjust_sampling_rate()
+ */
+const rate_decision_t *fft_last_rate_decision(void) {
+    return rate_controller_last(&g_rate_controller);
+}
+
+/* Streaming Spectrum ------------------------------------------------------ */
+/**
+ * @brief Feed one sample of the normal stream to the streaming spectrum
+ * @param sample Sample taken at g_sampling_frequency
+ * @note O(SDFT_WINDOW_SIZE/2) per call
+ */
+void fft_streaming_update(float sample) {
+    sdft_update(&g_spectrum, sample);
+}
+
+/**
+ * @brief Max frequency seen by the streaming spectrum
+ * @return Frequency (Hz), -1 until SDFT_WINDOW_SIZE samples were fed at the
+ * current rate or if no peak clears SDFT_MIN_AMPLITUDE
+ * @note Only content below g_sampling_frequency/2 is visible, a peak close
+ * to it is handled by the rate controller alias guard
+ */
+float fft_streaming_max_frequency(void) {
+    return sdft_max_frequency(&g_spectrum, g_sampling_frequency);
+}
+
+/**
+ * @brief Adapt sampling rate from the streaming spectrum
+ * @return true if the rate was re-evaluated without an acquisition burst,
+ * false if the caller has to fall back to a full FFT acquisition
+ * @details An estimate that raises the rate (new regime, alias guard or
+ * undersampled) may be folded content, so the rate is raised at once and
+ * the caller re-analyses instead of trusting it. Holding or lowering is
+ * decided from the stream alone.
+ */
+bool fft_streaming_adjust_sampling_rate(void) {
+    const float max_freq = fft_streaming_max_frequency();
+    if (max_freq <= 0) {
+        return false;
+    }
+    fft_adjust_sampling_rate(max_freq);
+    return fft_last_rate_decision()->action != RATE_RAISE;
 }
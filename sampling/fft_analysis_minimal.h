@@ -1,16 +1,14 @@
 #pragma once
-#include <arduinoFFT.h>
+#include <Arduino.h>
 #include "config.h"
+#include "rate_controller.h"
 
 // Mathematical constants
 #define PI 3.14159265358979323846f
-#define NYQUIST_MULTIPLIER 2.5f
 
 // FFT configuration
 extern float g_samples_real[NUM_SAMPLES];
-extern float g_samples_imag[NUM_SAMPLES];
 extern int g_sampling_frequency;
-extern ArduinoFFT<float> FFT;
 
 // Signal type
 typedef float (*signal_function)(float t);
@@ -26,5 +24,11 @@ void fft_init(void);
 void fft_process_signal(signal_function sig_func, int num_samples);
 float fft_get_max_frequency(void);
 float fft_perform_analysis(void);
+float fft_perform_burst_analysis(int num_samples);
 void fft_adjust_sampling_rate(float max_freq);
+void fft_recalibrate_sampling_rate(void);
+const rate_decision_t *fft_last_rate_decision(void);
+void fft_streaming_update(float sample);
+float fft_streaming_max_frequency(void);
+bool fft_streaming_adjust_sampling_rate(void);
 void fft_sampling_task(void *pvParameters);
\ No newline at end of file
@@ -0,0 +1,231 @@
+#pragma once
+#include <stdint.h>
+#include <math.h>
+
+/*
+ * Compile-time real-input FFT plan
+ * FftPlan<N, W> transforms N real samples as N/2 interleaved complex values and
+ * splits the result into the N/2+1 unique bins of the real spectrum. Window,
+ * twiddle and bit-reversal tables are generated by the compiler and live in
+ * flash, so a run only costs the window multiply and the butterflies.
+ * Written against C++11 constexpr rules (single-expression functions).
+ */
+
+// Window types
+enum fft_window_t {
+    FFT_WINDOW_RECTANGLE,
+    FFT_WINDOW_HAMMING,
+    FFT_WINDOW_HANN
+};
+
+namespace fft_detail {
+
+/* Constexpr Math ---------------------------------------------------------- */
+constexpr double CT_PI = 3.14159265358979323846;
+
+constexpr double ct_reduce(double x) {
+    return x > CT_PI ? ct_reduce(x - 2 * CT_PI) : (x < -CT_PI ? ct_reduce(x + 2 * CT_PI) : x);
+}
+
+constexpr double ct_sin_series(double x2, double term, int n, double acc) {
+    return n > 14 ? acc : ct_sin_series(x2, -term * x2 / ((2 * n) * (2 * n + 1)), n + 1, acc + term);
+}
+
+constexpr double ct_cos_series(double x2, double term, int n, double acc) {
+    return n > 14 ? acc : ct_cos_series(x2, -term * x2 / ((2 * n - 1) * (2 * n)), n + 1, acc + term);
+}
+
+constexpr double ct_sin_reduced(double x) { return ct_sin_series(x * x, x, 1, 0.0); }
+constexpr double ct_cos_reduced(double x) { return ct_cos_series(x * x, 1.0, 1, 0.0); }
+constexpr double ct_sin(double x) { return ct_sin_reduced(ct_reduce(x)); }
+constexpr double ct_cos(double x) { return ct_cos_reduced(ct_reduce(x)); }
+
+constexpr uint16_t ct_bit_reverse(uint16_t v, uint16_t bits, uint16_t acc) {
+    return bits == 0 ? acc : ct_bit_reverse(v >> 1, bits - 1, (uint16_t)((acc << 1) | (v & 1)));
+}
+
+constexpr uint16_t ct_log2(uint16_t n) { return n <= 1 ? 0 : 1 + ct_log2(n >> 1); }
+
+/* Index Sequence (log-depth, C++11) --------------------------------------- */
+template <uint16_t... I> struct index_seq {};
+
+template <typename A, typename B> struct seq_concat;
+template <uint16_t... A, uint16_t... B>
+struct seq_concat<index_seq<A...>, index_seq<B...> > {
+    typedef index_seq<A..., (uint16_t)(sizeof...(A) + B)...> type;
+};
+
+template <uint16_t N> struct make_index_seq {
+    typedef typename seq_concat<typename make_index_seq<N / 2>::type,
+                                typename make_index_seq<N - N / 2>::type>::type type;
+};
+template <> struct make_index_seq<0> { typedef index_seq<> type; };
+template <> struct make_index_seq<1> { typedef index_seq<0> type; };
+
+/* Table Generators -------------------------------------------------------- */
+// cos/sin of -2*pi*k/N for 0 <= k < N/2
+template <uint16_t N> struct twiddle_re_gen {
+    typedef float value_type;
+    static constexpr float at(uint16_t k) { return (float)ct_cos(-2 * CT_PI * k / N); }
+};
+template <uint16_t N> struct twiddle_im_gen {
+    typedef float value_type;
+    static constexpr float at(uint16_t k) { return (float)ct_sin(-2 * CT_PI * k / N); }
+};
+
+// Bit-reversed index for an M-point complex FFT
+template <uint16_t M> struct bit_reverse_gen {
+    typedef uint16_t value_type;
+    static constexpr uint16_t at(uint16_t k) { return ct_bit_reverse(k, ct_log2(M), 0); }
+};
+
+// First half of a symmetric window of length N
+template <uint16_t N, fft_window_t W> struct window_gen {
+    typedef float value_type;
+    static constexpr float at(uint16_t i) {
+        return W == FFT_WINDOW_HAMMING ? (float)(0.54 - 0.46 * ct_cos(2 * CT_PI * i / (N - 1)))
+             : W == FFT_WINDOW_HANN    ? (float)(0.5 - 0.5 * ct_cos(2 * CT_PI * i / (N - 1)))
+             : 1.0f;
+    }
+};
+
+template <typename Gen, typename Seq> struct ct_table;
+template <typename Gen, uint16_t... I>
+struct ct_table<Gen, index_seq<I...> > {
+    static constexpr typename Gen::value_type values[sizeof...(I)] = { Gen::at(I)... };
+};
+template <typename Gen, uint16_t... I>
+constexpr typename Gen::value_type ct_table<Gen, index_seq<I...> >::values[sizeof...(I)];
+
+} // namespace fft_detail
+
+/* FFT Plan ---------------------------------------------------------------- */
+/**
+ * @brief Real-input FFT with compile-time tables
+ * @tparam N Number of real samples (power of two, 4..32768)
+ * @tparam W Window applied by window()
+ */
+template <uint16_t N, fft_window_t W>
+class FftPlan {
+    static_assert(N >= 4 && (N & (N - 1)) == 0, "FFT size must be a power of two >= 4");
+
+    static const uint16_t M = N / 2;  // complex points
+
+    typedef fft_detail::ct_table<fft_detail::twiddle_re_gen<N>, typename fft_detail::make_index_seq<N / 2>::type> twiddle_re;
+    typedef fft_detail::ct_table<fft_detail::twiddle_im_gen<N>, typename fft_detail::make_index_seq<N / 2>::type> twiddle_im;
+    typedef fft_detail::ct_table<fft_detail::bit_reverse_gen<N / 2>, typename fft_detail::make_index_seq<N / 2>::type> bit_reverse;
+    typedef fft_detail::ct_table<fft_detail::window_gen<N, W>, typename fft_detail::make_index_seq<N / 2>::type> window_half;
+
+public:
+    static const uint16_t SIZE = N;
+    static const uint16_t BINS = N / 2 + 1;
+
+    /**
+     * @brief Apply the plan's window in place
+     * @param data Real sample buffer of N floats
+     */
+    static void window(float *data) {
+        for (uint16_t i = 0; i < M; i++) {
+            const float w = window_half::values[i];
+            data[i] *= w;
+            data[N - 1 - i] *= w;
+        }
+    }
+
+    /**
+     * @brief Forward FFT of N real samples, in place
+     * @param data Real input of N floats, overwritten with the packed spectrum
+     * @details Output layout: data[0] = X[0], data[1] = X[N/2] (both purely
+     * real), then (re, im) of X[k] at data[2k], data[2k+1] for 0 < k < N/2.
+     */
+    static void forward(float *data) {
+        complex_fft(data);
+
+        // DC and Nyquist bins come from the first complex point
+        const float z0_re = data[0];
+        const float z0_im = data[1];
+        data[0] = z0_re + z0_im;
+        data[1] = z0_re - z0_im;
+
+        // Split step: combine Z[k] and Z[M-k] into X[k] and X[M-k]
+        for (uint16_t k = 1; k <= (M >> 1); k++) {
+            const uint16_t a = 2 * k;
+            const uint16_t b = 2 * (M - k);
+            const float w_re = twiddle_re::values[k];
+            const float w_im = twiddle_im::values[k];
+
+            // Even part: (Z[k] + conj(Z[M-k])) / 2
+            const float fe_re = 0.5f * (data[a] + data[b]);
+            const float fe_im = 0.5f * (data[a + 1] - data[b + 1]);
+            // Odd part: -j * (Z[k] - conj(Z[M-k])) / 2
+            const float fo_re = 0.5f * (data[a + 1] + data[b + 1]);
+            const float fo_im = -0.5f * (data[a] - data[b]);
+
+            const float t_re = w_re * fo_re - w_im * fo_im;
+            const float t_im = w_re * fo_im + w_im * fo_re;
+
+            data[a] = fe_re + t_re;
+            data[a + 1] = fe_im + t_im;
+            // X[M-k] = conj(Fe - W^k * Fo)
+            data[b] = fe_re - t_re;
+            data[b + 1] = t_im - fe_im;
+        }
+    }
+
+    /**
+     * @brief Convert a packed spectrum into magnitudes, in place
+     * @param data Output of forward()
+     * @post data[k] holds |X[k]| for 0 <= k <= N/2
+     */
+    static void magnitude(float *data) {
+        const float dc = data[0];
+        const float nyquist = data[1];
+
+        // Ascending order never overwrites a bin that has not been read yet
+        for (uint16_t k = 1; k < M; k++) {
+            const float re = data[2 * k];
+            const float im = data[2 * k + 1];
+            data[k] = sqrtf(re * re + im * im);
+        }
+        data[0] = fabsf(dc);
+        data[M] = fabsf(nyquist);
+    }
+
+private:
+    /**
+     * @brief In-place radix-2 complex FFT over M interleaved (re, im) pairs
+     */
+    static void complex_fft(float *data) {
+        for (uint16_t i = 0; i < M; i++) {
+            const uint16_t j = bit_reverse::values[i];
+            if (i < j) {
+                float tr = data[2 * i];
+                float ti = data[2 * i + 1];
+                data[2 * i] = data[2 * j];
+                data[2 * i + 1] = data[2 * j + 1];
+                data[2 * j] = tr;
+                data[2 * j + 1] = ti;
+            }
+        }
+
+        // W_M^k == W_N^(2k): a stage of length len steps the table by N/len
+        for (uint16_t len = 2; len <= M; len <<= 1) {
+            const uint16_t half = len >> 1;
+            const uint16_t stride = N / len;
+            for (uint16_t k = 0; k < half; k++) {
+                const float w_re = twiddle_re::values[k * stride];
+                const float w_im = twiddle_im::values[k * stride];
+                for (uint16_t i = k; i < M; i += len) {
+                    const uint16_t a = 2 * i;
+                    const uint16_t b = 2 * (i + half);
+                    const float t_re = w_re * data[b] - w_im * data[b + 1];
+                    const float t_im = w_re * data[b + 1] + w_im * data[b];
+                    data[b] = data[a] - t_re;
+                    data[b + 1] = data[a + 1] - t_im;
+                    data[a] += t_re;
+                    data[a + 1] += t_im;
+                }
+            }
+        }
+    }
+};
@@ -0,0 +1,72 @@
+#pragma once
+#include <stdint.h>
+#include <math.h>
+#include "order_statistics.h"
+
+/*
+ * Streaming Hampel detector
+ * A sample is an outlier when it is further from the median of the last N
+ * samples than a number of scaled median absolute deviations. The window is
+ * kept both in arrival order (to know which sample leaves) and in an
+ * OrderStatistics skiplist (for median and MAD), so a sample costs O(log N)
+ * to add and the test O(log^2 N), instead of sorting the window.
+ */
+
+// MAD to standard deviation of a normal distribution
+#define HAMPEL_MAD_SCALE 1.4826f
+
+template <uint16_t N>
+class HampelFilter {
+public:
+    static constexpr uint16_t CAPACITY = N;
+
+    HampelFilter() { reset(); }
+
+    /**
+     * @brief Forget every sample
+     */
+    void reset() {
+        sorted_.clear();
+        next_ = 0;
+        count_ = 0;
+    }
+
+    /**
+     * @brief Add a sample, the oldest one leaves a full window
+     */
+    void push(float sample) {
+        if (count_ == N) {
+            sorted_.erase(window_[next_]);
+        } else {
+            count_++;
+        }
+        sorted_.insert(sample);
+        window_[next_] = sample;
+        next_ = (next_ + 1 == N) ? 0 : next_ + 1;
+    }
+
+    uint16_t count() const { return count_; }
+    bool full() const { return count_ == N; }
+    float median() const { return sorted_.median(); }
+    float mad() const { return sorted_.mad(); }
+
+    /**
+     * @brief Test a sample against the current window
+     * @param sample Sample to test, not added
+     * @param threshold Allowed distance from the median in scaled MADs
+     * @return true if the sample is an outlier
+     */
+    bool outlier(float sample, float threshold) const {
+        if (count_ == 0) {
+            return false;
+        }
+        const float m = median();
+        return fabsf(sample - m) > threshold * HAMPEL_MAD_SCALE * sorted_.mad(m);
+    }
+
+private:
+    OrderStatistics<N> sorted_;
+    float window_[N];
+    uint16_t next_;
+    uint16_t count_;
+};
@@ -0,0 +1,200 @@
+#include "sample_history.h"
+#include <math.h>
+#include <string.h>
+#include "noise_floor.h"
+
+// Periodogram frequencies for a full history, HISTORY_OVERSAMPLING per 1/span up to the mean Nyquist
+#define HISTORY_MAX_FREQUENCIES (HISTORY_OVERSAMPLING * HISTORY_SIZE / 2)
+
+/// @brief Tapered, mean-free samples in time order, scratch for the noise floor afterwards
+static float s_x[HISTORY_SIZE];
+
+/// @brief Phasor e^{j*w*t} of every sample at the current frequency and its step per frequency
+static float s_re[HISTORY_SIZE];
+static float s_im[HISTORY_SIZE];
+static float s_step_re[HISTORY_SIZE];
+static float s_step_im[HISTORY_SIZE];
+
+/// @brief Normalised periodogram, index k is frequency k/(HISTORY_OVERSAMPLING*span)
+static float s_power[HISTORY_MAX_FREQUENCIES + 1];
+
+
+/* Ring Buffer -------------------------------------------------------------- */
+/**
+ * @brief Forget every sample
+ * @param history History state
+ */
+void sample_history_reset(sample_history_t *history) {
+    memset(history, 0, sizeof(*history));
+}
+
+/**
+ * @brief Add a sample, the oldest one leaves a full history
+ * @param history History state
+ * @param value Sample
+ * @param time_us Time the sample was taken (µs), non-decreasing
+ */
+void sample_history_push(sample_history_t *history, float value, uint32_t time_us) {
+    history->value[history->next] = value;
+    history->time_us[history->next] = time_us;
+    history->next = (history->next + 1 == HISTORY_SIZE) ? 0 : history->next + 1;
+    if (history->count < HISTORY_SIZE) {
+        history->count++;
+    }
+}
+
+/**
+ * @brief Number of samples in the history
+ * @param history History state
+ */
+uint16_t sample_history_count(const sample_history_t *history) {
+    return history->count;
+}
+
+/**
+ * @brief Slot of the oldest sample
+ * @param history History state
+ */
+static uint16_t sample_history_first(const sample_history_t *history) {
+    return (history->next + HISTORY_SIZE - history->count) % HISTORY_SIZE;
+}
+
+/**
+ * @brief Mean Nyquist frequency of the history
+ * @param history History state
+ * @return Half the mean sampling rate (Hz), 0 with fewer than two samples
+ */
+float sample_history_nyquist(const sample_history_t *history) {
+    const uint16_t n = history->count;
+    const uint16_t first = sample_history_first(history);
+    if (n < 2) {
+        return 0.0f;
+    }
+    const uint32_t span_us = history->time_us[(first + n - 1) % HISTORY_SIZE] - history->time_us[first];
+    return span_us > 0 ? 0.5f * (n - 1) / (span_us * 1e-6f) : 0.0f;
+}
+
+
+/* Lomb-Scargle Periodogram ------------------------------------------------- */
+/**
+ * @brief Identify max frequency component of the history
+ * @param history History state
+ * @param alias_fraction Fraction of the mean Nyquist frequency above which a
+ * peak may be aliased content from above it
+ * @return Frequency (Hz) of the highest significant peak, -1 if the history
+ * is inconclusive: fewer than HISTORY_MIN_SAMPLES samples, no significant
+ * peak, a peak above alias_fraction of Nyquist, or a peak or the strongest
+ * component with fewer than HISTORY_MIN_CYCLES cycles over the history
+ * @details Lomb-Scargle periodogram on a grid of HISTORY_OVERSAMPLING points
+ * per 1/span up to the mean Nyquist frequency (n - 1) / (2 * span). The
+ * samples are Hann-tapered over the span, so the sidelobes of a strong
+ * component stay below weak ones. The phasor of every sample is rotated from
+ * one frequency to the next instead of calling sin/cos, O(n) multiplies per
+ * frequency. As for the FFT (noise_floor.h) a peak counts when it clears the
+ * median power of the independent frequencies by HISTORY_SNR_MARGIN and sits
+ * within HISTORY_DYNAMIC_RANGE of the strongest one.
+ * @note Content above the Nyquist frequency of the history folds back below
+ * it and cannot be told apart, the caller then needs a burst at a higher rate
+ * @note Works in static scratch, not reentrant
+ */
+float sample_history_max_frequency(const sample_history_t *history, float alias_fraction) {
+    const uint16_t n = history->count;
+    const uint16_t first = sample_history_first(history);
+    if (n < HISTORY_MIN_SAMPLES) {
+        return -1;
+    }
+    const float nyquist = sample_history_nyquist(history);
+    if (nyquist <= 0.0f) {
+        return -1;
+    }
+    const uint32_t t0 = history->time_us[first];
+    const float span = 0.5f * (n - 1) / nyquist;
+    const float df = 1.0f / (HISTORY_OVERSAMPLING * span);
+    const uint16_t frequencies = HISTORY_OVERSAMPLING * (n - 1) / 2;
+
+    float mean = 0.0f;
+    for (uint16_t i = 0; i < n; i++) {
+        mean += history->value[(first + i) % HISTORY_SIZE];
+    }
+    mean /= n;
+
+    float variance = 0.0f;
+    for (uint16_t i = 0; i < n; i++) {
+        const uint16_t slot = (first + i) % HISTORY_SIZE;
+        const float t = (uint32_t)(history->time_us[slot] - t0) * 1e-6f;
+        const float taper = 0.5f - 0.5f * cosf(2.0f * (float)M_PI * t / span);
+        s_x[i] = (history->value[slot] - mean) * taper;
+        variance += s_x[i] * s_x[i];
+
+        const float step = 2.0f * (float)M_PI * df * t;
+        s_step_re[i] = cosf(step);
+        s_step_im[i] = sinf(step);
+        s_re[i] = s_step_re[i];
+        s_im[i] = s_step_im[i];
+    }
+    variance /= (n - 1);
+    if (variance <= 0.0f) {
+        return -1;
+    }
+
+    float strongest = 0.0f;
+    uint16_t k_strongest = 0;
+    s_power[0] = 0.0f;
+    for (uint16_t k = 1; k <= frequencies; k++) {
+        float xc = 0.0f, xs = 0.0f, c2 = 0.0f, s2 = 0.0f;
+        for (uint16_t i = 0; i < n; i++) {
+            const float c = s_re[i];
+            const float s = s_im[i];
+            xc += s_x[i] * c;
+            xs += s_x[i] * s;
+            c2 += c * c - s * s;
+            s2 += 2.0f * c * s;
+            s_re[i] = c * s_step_re[i] - s * s_step_im[i];
+            s_im[i] = c * s_step_im[i] + s * s_step_re[i];
+        }
+        // Offset tau with tan(2*w*tau) = s2 / c2 makes the cosine and sine terms orthogonal
+        const float r = sqrtf(c2 * c2 + s2 * s2);
+        const float cos_2tau = r > 0.0f ? c2 / r : 1.0f;
+        const float cos_tau = sqrtf(0.5f * (1.0f + cos_2tau));
+        const float sin_tau = copysignf(sqrtf(0.5f * (1.0f - cos_2tau)), s2);
+        const float yc = cos_tau * xc + sin_tau * xs;
+        const float ys = cos_tau * xs - sin_tau * xc;
+        const float cc = 0.5f * (n + r);
+        const float ss = 0.5f * (n - r);
+        float power = yc * yc / cc;
+        if (ss > 1e-3f * n) {
+            power += ys * ys / ss;
+        }
+        s_power[k] = power / (2.0f * variance);
+        if (s_power[k] > strongest) {
+            strongest = s_power[k];
+            k_strongest = k;
+        }
+    }
+
+    // Most of the power below HISTORY_MIN_CYCLES, the signal is slower than the history spans
+    if (k_strongest < HISTORY_MIN_CYCLES * HISTORY_OVERSAMPLING) {
+        return -1;
+    }
+
+    // Median over the independent frequencies, the tapered samples are no longer needed
+    uint16_t independent = 0;
+    for (uint16_t k = HISTORY_OVERSAMPLING; k <= frequencies; k += HISTORY_OVERSAMPLING) {
+        s_x[independent++] = s_power[k];
+    }
+    const float noise = HISTORY_SNR_MARGIN * select_kth(s_x, independent, independent >> 1);
+    const float sidelobe = HISTORY_DYNAMIC_RANGE * strongest;
+    const float threshold = noise > sidelobe ? noise : sidelobe;
+
+    // Highest local maximum above the threshold
+    for (uint16_t k = frequencies - 1; k >= 1; k--) {
+        if (s_power[k] > s_power[k - 1] && s_power[k] >= s_power[k + 1] && s_power[k] > threshold) {
+            const float frequency = k * df;
+            if (frequency > alias_fraction * nyquist || frequency * span < HISTORY_MIN_CYCLES) {
+                return -1;
+            }
+            return frequency;
+        }
+    }
+    return -1;
+}
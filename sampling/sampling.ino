@@ -3,6 +3,10 @@
 #include <Arduino.h>
 #include "fft_analysis_minimal.h"
 #include "config.h"
+#include "window_stats.h"
+#include "hampel_filter.h"
+#include "spectral_change.h"
+#include "sample_history.h"
 #include "driver/uart.h"
 #include "esp_sleep.h"
 #include "esp_log.h"
@@ -13,35 +17,40 @@
 #define TASK_PRIORITY       2
 #define SERIAL_BAUD         115200
 
+#define ANOMALY_HAMPEL 1 // 1: Hampel filter (median/MAD), 0: standard deviation test
 #define THRESHOLD_STD_DEV 3.0f
+#define THRESHOLD_HAMPEL 3.0f // Distance from the median in scaled MADs
 #define MIN_SAMPLES_FOR_ANOMALY 10
 #define SAMPLING_WINDOW_SIZE 10
 
 // Task handles
 TaskHandle_t optimal_sampling_freq_task_handle = NULL;
 
-float sample_window[SAMPLING_WINDOW_SIZE];
-int window_index = 0;
+#if ANOMALY_HAMPEL
+HampelFilter<SAMPLING_WINDOW_SIZE> sample_window;  // Rolling median and MAD in O(log n) per sample
+#else
+WindowStats<float, SAMPLING_WINDOW_SIZE> sample_window;  // Mean and variance in O(1) per sample
+#endif
 int sample_count = 0;
+spectral_change_t spectrum_monitor;  // Decides when a re-analysis is needed
+sample_history_t history;  // Recent samples, first source of a re-analysis
+uint32_t sample_time_us = 0;  // Sample clock of the synthetic signal and the history
+int settle = 0;  // Samples of the new spectrum still to gather before re-analysing from the history
 
 bool anomaly(float sample) {
     if (sample_count < MIN_SAMPLES_FOR_ANOMALY) {
         return false;
     }
 
-    float mean = 0.0f;
-    float variance = 0.0f;
-    int size = min(sample_count, SAMPLING_WINDOW_SIZE);
-
-    for (int i = 0; i < size; i++) {
-        mean += sample_window[(window_index - size + i + SAMPLING_WINDOW_SIZE) % SAMPLING_WINDOW_SIZE];
-    }
-    mean /= size;
-
-    for (int i = 0; i < size; i++) {
-        variance += powf(sample_window[(window_index - size + i + SAMPLING_WINDOW_SIZE) % SAMPLING_WINDOW_SIZE] - mean, 2);
+#if ANOMALY_HAMPEL
+    if (sample_window.outlier(sample, THRESHOLD_HAMPEL)) {
+      Serial.printf("Median: %.2f - MAD: %.2f\n", sample_window.median(), sample_window.mad());
+      return true;
     }
-    variance /= size;
+    return false;
+#else
+    float mean = sample_window.mean();
+    float variance = sample_window.variance();
 
     float std_dev = sqrtf(variance);
     float diff = fabsf(sample - mean);
@@ -51,21 +60,66 @@ bool anomaly(float sample) {
       return true;
     }
     return false;
+#endif
+}
+
+/**
+ * @brief Burst length that covers the band above the history
+ * @param band Highest frequency the history can vouch for (Hz)
+ * @return Samples at INIT_SAMPLE_RATE holding HISTORY_BURST_CYCLES cycles at
+ * band, a power of two between HISTORY_MIN_BURST and NUM_SAMPLES
+ */
+int burst_length(float band) {
+    int length = HISTORY_MIN_BURST;
+    while (length < NUM_SAMPLES && length * band < HISTORY_BURST_CYCLES * INIT_SAMPLE_RATE) {
+        length <<= 1;
+    }
+    return length;
 }
 
 /**
  * @brief FFT and Compute optimal sampling frequency
+ * @param signal Signal to acquire if a burst is needed
+ * @param history Samples of the current spectrum, NULL for a full burst
+ * @details A re-analysis first looks at the history. When it finds the max
+ * frequency of its own band, a full-rate history decides alone and otherwise
+ * a short zero-padded burst at INIT_SAMPLE_RATE (burst_length()) only checks
+ * for content above that band, which the history would see aliased. An
+ * inconclusive history, or a band too low for a short burst to cover, falls
+ * back to the full NUM_SAMPLES burst as before.
  */
-void optimal_sampling_freq(signal_function signal) {
+void optimal_sampling_freq(signal_function signal, const sample_history_t *history) {
     Serial.println("[FFT] Signal sampling task started");
 
-    g_sampling_frequency = INIT_SAMPLE_RATE;
+    float max_frequency = -1;
+    float band = 0;
+    int burst = NUM_SAMPLES;
+    if (history) {
+        // Peaks in the Nyquist safety band of the history may be aliased
+        const float nyquist = sample_history_nyquist(history);
+        max_frequency = sample_history_max_frequency(history, 2.0f / NYQUIST_MULTIPLIER);
+        if (max_frequency > 0) {
+            band = 2.0f / NYQUIST_MULTIPLIER * nyquist;
+            burst = lroundf(2 * nyquist) >= INIT_SAMPLE_RATE ? 0 : burst_length(band);
+        }
+        Serial.printf("[HISTORY] %u samples, max frequency %.2f Hz, burst of %d samples\n",
+                      sample_history_count(history), max_frequency, burst);
+    }
 
-    fft_process_signal(signal, NUM_SAMPLES);
-    float max_frequency = fft_perform_analysis();
+    fft_recalibrate_sampling_rate();
+    if (burst > 0) {
+        fft_process_signal(signal, burst);
+        const float burst_frequency = fft_perform_burst_analysis(burst);
+        // A short burst only covers the band above the history, which resolves its own band better
+        if (burst == NUM_SAMPLES || burst_frequency > band) {
+            max_frequency = burst_frequency;
+        }
+    }
     
     Serial.printf("[FFT] Max frequency: %.2f Hz\n", max_frequency);
-    fft_adjust_sampling_rate(max_frequency);
+    if (max_frequency > 0) {
+        fft_adjust_sampling_rate(max_frequency);
+    }
     Serial.printf("[FFT] Adjusted sampling rate: %d Hz\n", g_sampling_frequency);
     Serial.println("[FFT] Sampling task complete");
 
@@ -77,7 +131,9 @@ void optimal_sampling_freq(signal_function signal) {
 void sampling_task(void *pvParameters) {
     float sample = 0.0f;
     signal_function signal = signal_low_freq;
-    optimal_sampling_freq(signal);
+    optimal_sampling_freq(signal, NULL);
+    sample_history_reset(&history);
+    spectral_change_init(&spectrum_monitor, g_sampling_frequency);
     Serial.printf("[SAMPLING] Starting sampling at %d Hz\n", g_sampling_frequency);
     Serial.println("--------------------------------");
     while (1) {
@@ -85,22 +141,50 @@ void sampling_task(void *pvParameters) {
             if (i == 100)
                 signal = signal_medium_freq;
 
-            sample = sample_signal(signal, i, g_sampling_frequency);
+            // A sensor sample would be stamped with esp_timer_get_time()
+            sample = signal((float)(sample_time_us * 1e-6));
+            sample_history_push(&history, sample, sample_time_us);
+            sample_time_us += 1000000 / g_sampling_frequency;
+            fft_streaming_update(sample);
             Serial.printf("[SAMPLING] Sample %d: %.2f\n", i, sample);
 
             uart_wait_tx_idle_polling((uart_port_t)CONFIG_ESP_CONSOLE_UART_NUM);
             esp_sleep_enable_timer_wakeup(1000*1000*1/g_sampling_frequency);
             esp_light_sleep_start();
             
-            if (anomaly(sample)) {
-                Serial.printf("[ANOMALY] Anomaly detected: Amp: %.2f\n", sample);
-                optimal_sampling_freq(signal);
-                window_index = 0;
+            // Outliers alone are reported, only a change of the spectrum costs a re-analysis
+            const bool outlier = anomaly(sample);
+            bool reanalysed = false;
+            if (settle > 0) {
+                // The history now only holds samples of the new spectrum
+                if (--settle == 0) {
+                    optimal_sampling_freq(signal, &history);
+                    reanalysed = true;
+                }
+            } else if (spectral_change_update(&spectrum_monitor, sample)) {
+                Serial.printf("[CHANGE] Spectrum changed at sample %d\n", i);
+                if (fft_streaming_adjust_sampling_rate()) {
+                    Serial.printf("[SDFT] Adjusted sampling rate: %d Hz\n", g_sampling_frequency);
+                    reanalysed = true;
+                } else if (burst_length(g_sampling_frequency / NYQUIST_MULTIPLIER) < NUM_SAMPLES) {
+                    // The history can spare most of the burst, refill it first
+                    Serial.printf("[HISTORY] Gathering %d samples\n", HISTORY_SIZE);
+                    settle = HISTORY_SIZE;
+                } else {
+                    optimal_sampling_freq(signal, NULL);
+                    reanalysed = true;
+                }
+            }
+            if (reanalysed) {
+                spectral_change_set_rate(&spectrum_monitor, g_sampling_frequency);
+                spectral_change_reset(&spectrum_monitor);
+                sample_window.reset();
                 sample_count = 0;
+            } else if (outlier) {
+                Serial.printf("[ANOMALY] Anomaly detected: Amp: %.2f, spectrum unchanged\n", sample);
             }
             
-            sample_window[window_index] = sample;
-            window_index = (window_index + 1) % SAMPLING_WINDOW_SIZE;
+            sample_window.push(sample);
             sample_count++;
         }
         Serial.println("--------------------------------");
@@ -1,5 +1,11 @@
 #pragma once
 #define WINDOW_SIZE 5
+#define TIME_WINDOW_SIZE_MS 700 // Averaging window of one duty cycle
+#define TIME_WINDOW_SLIDING_PANES 5 // Steps per window length of sliding windows
+#define TIME_WINDOW_MAX_PANES 2 // Pane ring length, a tumbling window needs 2
+#define QUANTILE_SKETCH_K 64 // Capacity of the top compactor, rank error near 1/K
+#define QUANTILE_SKETCH_MAX_LEVELS 20 // Compactors, a sketch holds about K * 2^levels samples
+#define LORA_SKETCH_BYTES 87 // Most sketch bytes after the 28-byte record, fewer if the data rate allows fewer (EU868: 87 at DR3, record only at DR0-2)
 
 #define WIFI_MAX_RETRIES 10
 #define MSG_BUFFER_SIZE 50
@@ -9,7 +15,21 @@
 #define SUBSCRIBE_TOPIC "luca/esp32/acks"
 
 #define INIT_SAMPLE_RATE 1000 // Hz
+#define NYQUIST_MULTIPLIER 2.5f // Sampling rate / max frequency
+#define RATE_MIN 1 // Hz
+#define RATE_MAX INIT_SAMPLE_RATE // Hz
+#define RATE_LOWER_RATIO 0.8f // Lower only if the required rate is below this fraction of the current one
+#define RATE_LOWER_HOLD 2 // Consecutive estimates needed to lower the rate
+#define RATE_MAX_STEP_UP 4 // Largest raise factor per decision
+#define RATE_MAX_STEP_DOWN 4 // Largest lowering factor per decision
+#define RATE_ALIAS_FRACTION 0.9f // Peaks above this fraction of Nyquist may be aliased
+#define RATE_CHANGE_TOLERANCE 0.1f // Relative estimate change treated as a new regime
 #define NUM_SAMPLES 1024
+#define FFT_FIXED_POINT 0 // 1: integer samples, Q15 FFT, integer peak search and averages
+#define ADC_RESOLUTION_BITS 12
+#define FIXED_SAMPLE_SCALE 100 // ADC codes per signal unit
+#define SIGNAL_MAX_TONES 4 // Tones per synthetic signal
+#define SIGNAL_RESYNC_INTERVAL 1024 // Samples between exact recomputations of the tone phasors
 #define QUEUE_SIZE NUM_OF_SAMPLES_AGGREGATE
 
 #define NUM_OF_SAMPLES_AGGREGATE 100
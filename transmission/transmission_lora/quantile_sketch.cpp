@@ -0,0 +1,378 @@
+#include "quantile_sketch.h"
+#include <string.h>
+#include <math.h>
+
+/* Compactors --------------------------------------------------------------- */
+/**
+ * @brief Items stored at a level
+ */
+static inline uint16_t level_size(const quantile_sketch_t *s, uint8_t h) {
+    return s->levels[h + 1] - s->levels[h];
+}
+
+/**
+ * @brief Capacity of a level, k at the top and 2/3 of the one above below it
+ * @param s Sketch
+ * @param h Level
+ * @param k Capacity of the top level
+ * @param min_capacity Smallest capacity of a level
+ */
+static uint16_t level_capacity(const quantile_sketch_t *s, uint8_t h, uint16_t k, uint16_t min_capacity) {
+    uint16_t capacity = k;
+    for (uint8_t depth = s->num_levels - 1 - h; depth > 0 && capacity > min_capacity; depth--) {
+        capacity = capacity * 2 / 3;
+    }
+    return capacity < min_capacity ? min_capacity : capacity;
+}
+
+/**
+ * @brief Next value of the xorshift generator of the compaction offsets
+ */
+static inline uint32_t next_random(quantile_sketch_t *s) {
+    s->seed ^= s->seed << 13;
+    s->seed ^= s->seed >> 17;
+    s->seed ^= s->seed << 5;
+    return s->seed;
+}
+
+/**
+ * @brief Sort a level in place (Shell sort, gaps of Ciura)
+ */
+static void sort_items(float *items, uint16_t n) {
+    static const uint16_t gaps[] = { 132, 57, 23, 10, 4, 1 };
+    for (uint8_t g = 0; g < sizeof(gaps) / sizeof(gaps[0]); g++) {
+        const uint16_t gap = gaps[g];
+        for (uint16_t i = gap; i < n; i++) {
+            const float value = items[i];
+            uint16_t j = i;
+            for (; j >= gap && items[j - gap] > value; j -= gap) {
+                items[j] = items[j - gap];
+            }
+            items[j] = value;
+        }
+    }
+}
+
+/**
+ * @brief Open an empty level on top
+ * @return false with QUANTILE_SKETCH_MAX_LEVELS levels already
+ */
+static bool add_level(quantile_sketch_t *s) {
+    if (s->num_levels == QUANTILE_SKETCH_MAX_LEVELS) {
+        return false;
+    }
+    s->num_levels++;
+    s->levels[s->num_levels] = QUANTILE_SKETCH_CAPACITY;
+    return true;
+}
+
+/**
+ * @brief Free slots at the start of a level
+ * @param s Sketch
+ * @param h Level
+ * @param n Slots, at most the free space s->levels[0]
+ * @return First slot, the lower levels move down to make room
+ */
+static float *make_room(quantile_sketch_t *s, uint8_t h, uint16_t n) {
+    const uint16_t first = s->levels[0];
+    memmove(&s->items[first - n], &s->items[first], (s->levels[h] - first) * sizeof(float));
+    for (uint8_t i = 0; i <= h; i++) {
+        s->levels[i] -= n;
+    }
+    return &s->items[s->levels[h]];
+}
+
+/**
+ * @brief Move pairs of items of a level into the one above
+ * @param s Sketch
+ * @param h Level with a level above
+ * @param pairs Pairs to compact, at most half of the level
+ * @details The level is sorted and every other one of its 2 * pairs largest
+ * items, from a random offset, moves up with twice the weight. The slots
+ * freed are returned to the free space.
+ */
+static void compact_level(quantile_sketch_t *s, uint8_t h, uint16_t pairs) {
+    const uint16_t start = s->levels[h];
+    const uint16_t end = s->levels[h + 1];
+    sort_items(&s->items[start], end - start);
+
+    const uint16_t half = pairs;
+    const uint16_t stay = end - 2 * half;
+    const uint16_t from = stay + (next_random(s) & 1);
+    // Downwards, a kept item never overwrites one still to be read
+    for (uint16_t i = half; i-- > 0;) {
+        s->items[end - half + i] = s->items[from + 2 * i];
+    }
+    s->levels[h + 1] = end - half;
+
+    const uint16_t first = s->levels[0];
+    memmove(&s->items[first + half], &s->items[first], (stay - first) * sizeof(float));
+    for (uint8_t i = 0; i <= h; i++) {
+        s->levels[i] += half;
+    }
+}
+
+/**
+ * @brief Compact the lowest level at or over its capacity
+ * @param s Sketch
+ * @param k Capacity of the top level
+ * @param min_capacity Smallest capacity of a level
+ * @param max_pairs Pairs to compact at most, the whole level if larger
+ * @return false if no level could be compacted
+ */
+static bool compact_one(quantile_sketch_t *s, uint16_t k, uint16_t min_capacity, uint16_t max_pairs) {
+    for (uint8_t h = 0; h < s->num_levels; h++) {
+        const uint16_t size = level_size(s, h);
+        if (size < 2 || size < level_capacity(s, h, k, min_capacity)) {
+            continue;
+        }
+        if (h + 1 == s->num_levels && !add_level(s)) {
+            continue;
+        }
+        compact_level(s, h, (max_pairs < size / 2) ? max_pairs : size / 2);
+        return true;
+    }
+    return false;
+}
+
+/* Stream ------------------------------------------------------------------- */
+/**
+ * @brief Empty the sketch
+ * @param s Sketch
+ */
+void quantile_sketch_init(quantile_sketch_t *s) {
+    memset(s, 0, sizeof(*s));
+    s->num_levels = 1;
+    s->levels[0] = QUANTILE_SKETCH_CAPACITY;
+    s->levels[1] = QUANTILE_SKETCH_CAPACITY;
+    s->seed = 0x9E3779B9UL;
+}
+
+/**
+ * @brief Add one sample
+ * @param s Sketch
+ * @param value Sample
+ * @note Only a sketch of about QUANTILE_SKETCH_K * 2^QUANTILE_SKETCH_MAX_LEVELS
+ * samples can fill its top level, later samples would then be ignored
+ */
+void quantile_sketch_add(quantile_sketch_t *s, float value) {
+    if (s->levels[0] == 0 && !compact_one(s, QUANTILE_SKETCH_K, QUANTILE_SKETCH_MIN_CAPACITY, UINT16_MAX)) {
+        return;
+    }
+    *make_room(s, 0, 1) = value;
+    s->min = s->count == 0 ? value : fminf(s->min, value);
+    s->max = s->count == 0 ? value : fmaxf(s->max, value);
+    s->count++;
+}
+
+/**
+ * @brief Add a run of samples
+ * @param s Sketch
+ * @param samples Samples
+ * @param count Number of samples
+ * @details The samples are copied into the free space in chunks, the
+ * compactions run between chunks.
+ */
+void quantile_sketch_add_samples(quantile_sketch_t *s, const fft_sample_t *samples, uint16_t count) {
+    if (count > 0 && s->count == 0) {
+        s->min = sample_to_float(samples[0]);
+        s->max = s->min;
+    }
+    float lo = s->min;
+    float hi = s->max;
+    uint16_t i = 0;
+    while (i < count) {
+        if (s->levels[0] == 0 && !compact_one(s, QUANTILE_SKETCH_K, QUANTILE_SKETCH_MIN_CAPACITY, UINT16_MAX)) {
+            break;
+        }
+        const uint16_t chunk = (count - i < s->levels[0]) ? count - i : s->levels[0];
+        float *dst = make_room(s, 0, chunk);
+        for (uint16_t j = 0; j < chunk; j++) {
+            const float value = sample_to_float(samples[i + j]);
+            dst[j] = value;
+            lo = fminf(lo, value);
+            hi = fmaxf(hi, value);
+        }
+        i += chunk;
+        s->count += chunk;
+    }
+    s->min = lo;
+    s->max = hi;
+}
+
+/**
+ * @brief Merge another sketch into this one
+ * @param s Sketch, receives the merge
+ * @param other Sketch of other samples, a window or a device
+ * @return false if s filled its top level, the merge is then incomplete
+ */
+bool quantile_sketch_merge(quantile_sketch_t *s, const quantile_sketch_t *other) {
+    if (other->count == 0) {
+        return true;
+    }
+    s->min = s->count == 0 ? other->min : fminf(s->min, other->min);
+    s->max = s->count == 0 ? other->max : fmaxf(s->max, other->max);
+    while (s->num_levels < other->num_levels) {
+        add_level(s);
+    }
+    for (uint8_t h = 0; h < other->num_levels; h++) {
+        const float *src = &other->items[other->levels[h]];
+        uint16_t left = level_size(other, h);
+        while (left > 0) {
+            if (s->levels[0] == 0 && !compact_one(s, QUANTILE_SKETCH_K, QUANTILE_SKETCH_MIN_CAPACITY, UINT16_MAX)) {
+                return false;
+            }
+            const uint16_t chunk = (left < s->levels[0]) ? left : s->levels[0];
+            memcpy(make_room(s, h, chunk), src, chunk * sizeof(float));
+            src += chunk;
+            left -= chunk;
+        }
+    }
+    s->count += other->count;
+    return true;
+}
+
+/* Queries ------------------------------------------------------------------ */
+/**
+ * @brief Approximate quantile
+ * @param s Sketch, its levels are sorted in place
+ * @param q Quantile, 0.5 for the median
+ * @return Smallest item whose weighted rank exceeds q * count, NAN if empty
+ */
+float quantile_sketch_quantile(quantile_sketch_t *s, float q) {
+    if (s->count == 0) {
+        return NAN;
+    }
+    if (q <= 0.0f) {
+        return s->min;
+    }
+    if (q >= 1.0f) {
+        return s->max;
+    }
+    uint16_t next[QUANTILE_SKETCH_MAX_LEVELS];
+    for (uint8_t h = 0; h < s->num_levels; h++) {
+        sort_items(&s->items[s->levels[h]], level_size(s, h));
+        next[h] = s->levels[h];
+    }
+
+    // Walk the levels in value order until the rank is passed
+    const float target = q * s->count;
+    uint32_t rank = 0;
+    while (true) {
+        int16_t best = -1;
+        for (uint8_t h = 0; h < s->num_levels; h++) {
+            if (next[h] < s->levels[h + 1] && (best < 0 || s->items[next[h]] < s->items[next[best]])) {
+                best = h;
+            }
+        }
+        if (best < 0) {
+            return s->max;
+        }
+        rank += 1UL << best;
+        if (rank > target) {
+            return s->items[next[best]];
+        }
+        next[best]++;
+    }
+}
+
+/* Serialization ------------------------------------------------------------ */
+/**
+ * @brief Serialize into at most max_bytes
+ * @param s Sketch, compacted in place until it fits
+ * @param buf Receives the sketch
+ * @param max_bytes Budget, e.g. the room left in a LoRa frame
+ * @return Bytes written, 0 if even the smallest form does not fit
+ * @details Little-endian: version, number of levels, count (u32), min and
+ * max (f32), the item count of every level (u8) and the items of level 0
+ * upwards as u16 steps of (max - min) / 65535. Every item of level h
+ * stands for 2^h samples. The capacities are lowered by 3/4 until the
+ * sketch fits, the last compaction only moves the pairs still in excess.
+ */
+uint16_t quantile_sketch_serialize(quantile_sketch_t *s, uint8_t *buf, uint16_t max_bytes) {
+    uint16_t k = QUANTILE_SKETCH_K;
+    while (true) {
+        const uint16_t bytes = QUANTILE_SKETCH_HEADER_BYTES + s->num_levels +
+                               2 * (QUANTILE_SKETCH_CAPACITY - s->levels[0]);
+        uint16_t pairs = (bytes > max_bytes) ? (bytes - max_bytes + 1) / 2 : 0;
+        for (uint8_t h = 0; h < s->num_levels && pairs == 0; h++) {
+            pairs = (level_size(s, h) > UINT8_MAX) ? 1 : 0;
+        }
+        if (pairs == 0) {
+            break;
+        }
+        if (!compact_one(s, k, 2, pairs)) {
+            if (k == 2) {
+                return 0;
+            }
+            k = (k * 3 / 4 < 2) ? 2 : k * 3 / 4;
+        }
+    }
+
+    uint16_t n = 0;
+    buf[n++] = QUANTILE_SKETCH_VERSION;
+    buf[n++] = s->num_levels;
+    memcpy(&buf[n], &s->count, 4);
+    memcpy(&buf[n + 4], &s->min, 4);
+    memcpy(&buf[n + 8], &s->max, 4);
+    n += 12;
+    for (uint8_t h = 0; h < s->num_levels; h++) {
+        buf[n++] = (uint8_t)level_size(s, h);
+    }
+    const float scale = (s->max > s->min) ? 65535.0f / (s->max - s->min) : 0.0f;
+    for (uint8_t h = 0; h < s->num_levels; h++) {
+        for (uint16_t i = s->levels[h]; i < s->levels[h + 1]; i++) {
+            const float step = (s->items[i] - s->min) * scale + 0.5f;
+            const uint16_t code = step >= 65535.0f ? 65535 : (uint16_t)step;
+            buf[n++] = code & 0xFF;
+            buf[n++] = code >> 8;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Rebuild a serialized sketch, to merge or query it
+ * @param s Receives the sketch
+ * @param buf Output of quantile_sketch_serialize()
+ * @param len Bytes in buf
+ * @return false if buf is not a sketch of this version and capacity
+ */
+bool quantile_sketch_deserialize(quantile_sketch_t *s, const uint8_t *buf, uint16_t len) {
+    if (len < QUANTILE_SKETCH_HEADER_BYTES || buf[0] != QUANTILE_SKETCH_VERSION) {
+        return false;
+    }
+    const uint8_t num_levels = buf[1];
+    if (num_levels == 0 || num_levels > QUANTILE_SKETCH_MAX_LEVELS ||
+        len < QUANTILE_SKETCH_HEADER_BYTES + num_levels) {
+        return false;
+    }
+    const uint8_t *sizes = &buf[QUANTILE_SKETCH_HEADER_BYTES];
+    uint32_t items = 0;
+    uint32_t weight = 0;
+    for (uint8_t h = 0; h < num_levels; h++) {
+        items += sizes[h];
+        weight += (uint32_t)sizes[h] << h;
+    }
+    quantile_sketch_init(s);
+    memcpy(&s->count, &buf[2], 4);
+    memcpy(&s->min, &buf[6], 4);
+    memcpy(&s->max, &buf[10], 4);
+    if (items > QUANTILE_SKETCH_CAPACITY || weight != s->count ||
+        len != QUANTILE_SKETCH_HEADER_BYTES + num_levels + 2 * items) {
+        quantile_sketch_init(s);
+        return false;
+    }
+
+    s->num_levels = num_levels;
+    s->levels[num_levels] = QUANTILE_SKETCH_CAPACITY;
+    for (uint8_t h = num_levels; h-- > 0;) {
+        s->levels[h] = s->levels[h + 1] - sizes[h];
+    }
+    const float step = (s->max - s->min) / 65535.0f;
+    const uint8_t *code = &sizes[num_levels];
+    for (uint16_t i = s->levels[0]; i < QUANTILE_SKETCH_CAPACITY; i++, code += 2) {
+        s->items[i] = s->min + (code[0] | (code[1] << 8)) * step;
+    }
+    return true;
+}
@@ -0,0 +1,255 @@
+#include "sample_source.h"
+#include <string.h>
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Converts the float samples of the generator in chunks
+#define SYNTHETIC_CHUNK 32
+
+/* Synthetic Signals -------------------------------------------------------- */
+static uint16_t synthetic_read(sample_source_t *src, fft_sample_t *out, uint16_t count) {
+    synthetic_source_t *s = &src->synthetic;
+    if (!s->phasor) {
+        for (uint16_t i = 0; i < count; i++) {
+            out[i] = sample_from_float(s->sig_func((float)s->time));
+            s->time += 1.0 / src->sampling_frequency;
+        }
+        return count;
+    }
+    float chunk[SYNTHETIC_CHUNK];
+    uint16_t done = 0;
+    while (done < count) {
+        const uint16_t n = (count - done) < SYNTHETIC_CHUNK ? (count - done) : SYNTHETIC_CHUNK;
+        signal_generator_block(&s->gen, chunk, n);
+        for (uint16_t i = 0; i < n; i++) {
+            out[done + i] = sample_from_float(chunk[i]);
+        }
+        done += n;
+    }
+    return count;
+}
+
+static void synthetic_set_rate(sample_source_t *src) {
+    if (src->synthetic.phasor) {
+        signal_generator_set_rate(&src->synthetic.gen, src->sampling_frequency);
+    }
+}
+
+static const sample_source_ops_t SYNTHETIC_OPS = {synthetic_read, synthetic_set_rate, NULL};
+
+/**
+ * @brief Open a synthetic signal
+ * @param src Source state
+ * @param sig_func Signal function
+ * @param desc Tones of sig_func, NULL to evaluate sig_func for every sample
+ * @param sampling_frequency Rate in Hz
+ * @param start_index Index of the first sample at this rate
+ * @param paced Deliver the samples in real time
+ */
+void sample_source_open_synthetic(sample_source_t *src, signal_function sig_func, const signal_desc_t *desc,
+                                  int sampling_frequency, uint32_t start_index, bool paced) {
+    memset(src, 0, sizeof(*src));
+    src->ops = &SYNTHETIC_OPS;
+    src->name = "synthetic";
+    src->sampling_frequency = sampling_frequency;
+    src->paced = paced;
+
+    synthetic_source_t *s = &src->synthetic;
+    s->sig_func = sig_func;
+    s->phasor = desc != NULL;
+    s->time = (double)start_index / sampling_frequency;
+    if (s->phasor) {
+        signal_generator_init(&s->gen, desc, sampling_frequency);
+        signal_generator_seek(&s->gen, s->time);
+    }
+}
+
+/* Capture Files (host) ----------------------------------------------------- */
+#ifndef ARDUINO
+static uint16_t capture_read(sample_source_t *src, fft_sample_t *out, uint16_t count) {
+    capture_source_t *c = &src->capture;
+    uint16_t n = 0;
+    // Linear interpolation between the two capture samples around the position
+    while (n < count && c->position + 1 < c->num_samples) {
+        const uint32_t k = (uint32_t)c->position;
+        const float frac = (float)(c->position - k);
+        out[n++] = sample_from_float(c->samples[k] + frac * (c->samples[k + 1] - c->samples[k]));
+        c->position += c->step;
+    }
+    return n;
+}
+
+static void capture_set_rate(sample_source_t *src) {
+    src->capture.step = (double)src->capture.sampling_frequency / src->sampling_frequency;
+}
+
+static void capture_close(sample_source_t *src) {
+    munmap(src->capture.map, src->capture.map_size);
+    src->capture.map = NULL;
+}
+
+static const sample_source_ops_t CAPTURE_OPS = {capture_read, capture_set_rate, capture_close};
+
+/**
+ * @brief Open a capture file for replay
+ * @param src Source state
+ * @param path File in the sample_capture_header_t layout
+ * @param sampling_frequency Output rate in Hz, the capture is resampled to it
+ * @param paced Deliver the samples in real time, false replays as fast as read
+ * @return false if the file cannot be mapped or is not a capture
+ * @note The file is mapped, not read, so captures larger than memory work
+ */
+bool sample_source_open_capture(sample_source_t *src, const char *path, int sampling_frequency, bool paced) {
+    memset(src, 0, sizeof(*src));
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(sample_capture_header_t)) {
+        close(fd);
+        return false;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+
+    const sample_capture_header_t *header = (const sample_capture_header_t *)map;
+    const size_t payload = st.st_size - sizeof(*header);
+    if (header->magic != SAMPLE_CAPTURE_MAGIC || header->sampling_frequency == 0 ||
+        header->num_samples > payload / sizeof(float)) {
+        munmap(map, st.st_size);
+        return false;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+    src->ops = &CAPTURE_OPS;
+    src->name = "capture";
+    src->sampling_frequency = sampling_frequency;
+    src->paced = paced;
+
+    capture_source_t *c = &src->capture;
+    c->samples = (const float *)(header + 1);
+    c->num_samples = header->num_samples;
+    c->sampling_frequency = header->sampling_frequency;
+    c->map = map;
+    c->map_size = st.st_size;
+    capture_set_rate(src);
+    return true;
+}
+#endif
+
+/* ADC (device) ------------------------------------------------------------- */
+#ifdef ARDUINO
+static uint16_t adc_read(sample_source_t *src, fft_sample_t *out, uint16_t count) {
+    for (uint16_t i = 0; i < count; i++) {
+        // Signed code around mid-scale, FIXED_SAMPLE_SCALE codes per unit
+        const int code = analogRead(src->adc.pin) - (1 << (ADC_RESOLUTION_BITS - 1));
+        out[i] = sample_from_float((float)code / FIXED_SAMPLE_SCALE);
+    }
+    return count;
+}
+
+static const sample_source_ops_t ADC_OPS = {adc_read, NULL, NULL};
+
+/**
+ * @brief Open an ADC input
+ * @param src Source state
+ * @param pin Analog pin
+ * @param sampling_frequency Rate in Hz
+ * @note Always paced, a sensor cannot be read ahead of time
+ */
+void sample_source_open_adc(sample_source_t *src, uint8_t pin, int sampling_frequency) {
+    memset(src, 0, sizeof(*src));
+    src->ops = &ADC_OPS;
+    src->name = "adc";
+    src->sampling_frequency = sampling_frequency;
+    src->paced = true;
+    src->adc.pin = pin;
+    analogReadResolution(ADC_RESOLUTION_BITS);
+}
+#endif
+
+/* Common Interface --------------------------------------------------------- */
+/**
+ * @brief Read consecutive samples
+ * @param src Source state
+ * @param out Destination, count samples
+ * @param count Number of samples
+ * @return Samples read, less than count once the source is exhausted
+ * @note A paced source waits for every sampling deadline except the one of the
+ * very first sample, which starts the scheduler in the calling task
+ */
+uint16_t sample_source_read(sample_source_t *src, fft_sample_t *out, uint16_t count) {
+    if (!src->paced) {
+        const uint16_t n = src->ops->read(src, out, count);
+        src->produced += n;
+        return n;
+    }
+    uint16_t n = 0;
+    while (n < count) {
+        if (src->started) {
+            sample_scheduler_wait(&src->sched);
+        } else {
+            sample_scheduler_start(&src->sched, src->sampling_frequency);
+            src->started = true;
+        }
+        if (src->ops->read(src, out + n, 1) == 0) {
+            break;
+        }
+        n++;
+    }
+    src->produced += n;
+    return n;
+}
+
+/**
+ * @brief Change the output rate
+ * @param src Source state
+ * @param sampling_frequency Rate in Hz
+ * @note No-op if the rate is unchanged
+ */
+void sample_source_set_rate(sample_source_t *src, int sampling_frequency) {
+    if (sampling_frequency == src->sampling_frequency) {
+        return;
+    }
+    src->sampling_frequency = sampling_frequency;
+    if (src->ops->set_rate != NULL) {
+        src->ops->set_rate(src);
+    }
+    if (src->started) {
+        sample_scheduler_set_rate(&src->sched, sampling_frequency);
+    }
+}
+
+/**
+ * @brief Stop the pacing until the next read
+ * @param src Source state
+ * @note The next read starts the scheduler again, in the task that reads, so a
+ * source can be handed to another task after a pause
+ */
+void sample_source_pause(sample_source_t *src) {
+    if (src->started) {
+        sample_scheduler_stop(&src->sched);
+        src->started = false;
+    }
+}
+
+/**
+ * @brief Stop the pacing and release the source
+ * @param src Source state
+ */
+void sample_source_close(sample_source_t *src) {
+    sample_source_pause(src);
+    if (src->ops != NULL && src->ops->close != NULL) {
+        src->ops->close(src);
+    }
+}
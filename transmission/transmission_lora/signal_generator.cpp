@@ -0,0 +1,140 @@
+#include "signal_generator.h"
+#include <math.h>
+#include <string.h>
+
+static const double TWO_PI = 6.28318530717958647692;
+
+/**
+ * @brief Recompute every phasor exactly for the current sample index
+ * @param gen Generator state
+ */
+static void signal_generator_resync(signal_generator_t *gen) {
+    // Fold the elapsed samples into the origin so the index never overflows
+    const double t = signal_generator_time(gen);
+    gen->time_origin = t;
+    gen->index = 0;
+    for (uint8_t k = 0; k < gen->num_tones; k++) {
+        const tone_t *tone = &gen->tones[k];
+        // Whole cycles are dropped before the multiply to keep the precision
+        const double cycles = tone->frequency * t;
+        const double angle = TWO_PI * (cycles - floor(cycles)) + tone->phase;
+        gen->re[k] = (float)(tone->amplitude * cos(angle));
+        gen->im[k] = (float)(tone->amplitude * sin(angle));
+    }
+    gen->next_resync = SIGNAL_RESYNC_INTERVAL;
+}
+
+/**
+ * @brief Set up a generator for a signal
+ * @param gen Generator state
+ * @param desc Tones of the signal, at most SIGNAL_MAX_TONES are used
+ * @param sampling_frequency Rate in Hz
+ */
+void signal_generator_init(signal_generator_t *gen, const signal_desc_t *desc, int sampling_frequency) {
+    memset(gen, 0, sizeof(*gen));
+    gen->num_tones = desc->num_tones < SIGNAL_MAX_TONES ? desc->num_tones : SIGNAL_MAX_TONES;
+    memcpy(gen->tones, desc->tones, gen->num_tones * sizeof(tone_t));
+    signal_generator_set_rate(gen, sampling_frequency);
+}
+
+/**
+ * @brief Change the sampling rate, the signal continues without a phase jump
+ * @param gen Generator state
+ * @param sampling_frequency Rate in Hz
+ */
+void signal_generator_set_rate(signal_generator_t *gen, int sampling_frequency) {
+    if (sampling_frequency == gen->sampling_frequency) {
+        return;
+    }
+    if (gen->sampling_frequency > 0) {
+        gen->time_origin = signal_generator_time(gen);
+        gen->index = 0;
+    }
+    gen->sampling_frequency = sampling_frequency;
+    for (uint8_t k = 0; k < gen->num_tones; k++) {
+        const double step = TWO_PI * gen->tones[k].frequency / sampling_frequency;
+        gen->rot_re[k] = (float)cos(step);
+        gen->rot_im[k] = (float)sin(step);
+    }
+    signal_generator_resync(gen);
+}
+
+/**
+ * @brief Continue the signal from another time
+ * @param gen Generator state
+ * @param time Time of the next sample (s)
+ */
+void signal_generator_seek(signal_generator_t *gen, double time) {
+    gen->time_origin = time;
+    gen->index = 0;
+    signal_generator_resync(gen);
+}
+
+/**
+ * @brief Time of the next sample
+ * @param gen Generator state
+ * @return Seconds since the generator was initialised
+ */
+double signal_generator_time(const signal_generator_t *gen) {
+    return gen->time_origin + (double)gen->index / gen->sampling_frequency;
+}
+
+/**
+ * @brief Produce the next sample
+ * @param gen Generator state
+ * @return Signal value
+ */
+float signal_generator_next(signal_generator_t *gen) {
+    if (gen->index == gen->next_resync) {
+        signal_generator_resync(gen);
+    }
+    float value = 0.0f;
+    for (uint8_t k = 0; k < gen->num_tones; k++) {
+        const float re = gen->re[k];
+        const float im = gen->im[k];
+        value += im;
+        gen->re[k] = re * gen->rot_re[k] - im * gen->rot_im[k];
+        gen->im[k] = re * gen->rot_im[k] + im * gen->rot_re[k];
+    }
+    gen->index++;
+    return value;
+}
+
+/**
+ * @brief Produce consecutive samples
+ * @param gen Generator state
+ * @param out Destination, count samples
+ * @param count Number of samples
+ * @details Runs tone by tone over runs that end at resync points, which keeps
+ * the inner loop free of branches
+ */
+void signal_generator_block(signal_generator_t *gen, float *out, uint16_t count) {
+    uint16_t done = 0;
+    while (done < count) {
+        if (gen->index == gen->next_resync) {
+            signal_generator_resync(gen);
+        }
+        const uint32_t to_resync = gen->next_resync - gen->index;
+        const uint32_t left = count - done;
+        const uint16_t run = (uint16_t)(left < to_resync ? left : to_resync);
+
+        float *dst = out + done;
+        memset(dst, 0, run * sizeof(float));
+        for (uint8_t k = 0; k < gen->num_tones; k++) {
+            float re = gen->re[k];
+            float im = gen->im[k];
+            const float rot_re = gen->rot_re[k];
+            const float rot_im = gen->rot_im[k];
+            for (uint16_t i = 0; i < run; i++) {
+                dst[i] += im;
+                const float next_re = re * rot_re - im * rot_im;
+                im = re * rot_im + im * rot_re;
+                re = next_re;
+            }
+            gen->re[k] = re;
+            gen->im[k] = im;
+        }
+        gen->index += run;
+        done += run;
+    }
+}
@@ -4,6 +4,10 @@
 #include "freertos/queue.h"
 #include "LoRaWan_APP.h"
 #include <fft_analysis.h>
+#include "sample_source.h"
+#include "time_window.h"
+#include "quantile_sketch.h"
+#include "rate_controller.h"
 #include "driver/uart.h"
 #include "esp_sleep.h"
 #include "esp_log.h"
@@ -13,7 +17,6 @@
 #define LORA_JSON_BUFFER_SIZE 255
 #define LORA_DEVICE_ID "ESP32_LoRa"
 #define APP_TX_DUTYCYCLE_RND 1000
-#define WINDOW_SECONDS 0.7
 
 // OTAA Parameters (Over-the-Air Activation)
 uint8_t devEui[] = { 0x70, 0xB3, 0xD5, 0x7E, 0xD0, 0x06, 0xF8, 0xCD };
@@ -41,15 +44,16 @@ uint8_t confirmedNbTrials = 4;         // Transmission retries
 /* Persistent State --------------------------------------------------------- */
 // RTC-retained variables (survive deep sleep)
 RTC_DATA_ATTR int sample_i = 0;        // Sample index counter
+RTC_DATA_ATTR uint32_t sample_time_us = 0; // Nominal time of the next sample
 RTC_DATA_ATTR int freq = INIT_SAMPLE_RATE; // Current sampling frequency
 RTC_DATA_ATTR bool initialized = false;// Initialization flag
 RTC_DATA_ATTR int num_of_restarts = 0; // number of restarts
 
 
 /* Runtime Variables -------------------------------------------------------- */
-float avg = 0.0;                       // Current moving average
+aggregate_record_t record;             // Aggregate of the last window
+quantile_sketch_t sketch;              // Percentiles of the last window
 TaskHandle_t sampling_avg_task_handler = NULL; // Main task reference
-int window_size = 0;
 /* Signal Processing -------------------------------------------------------- */
 
 void fft_inizialization(){
@@ -64,37 +68,54 @@ void fft_inizialization(){
   float max_freq = fft_get_max_frequency();
 
   Serial.printf("[FFT] Peak frequency: %.2f Hz\n", max_freq);
-  freq = (g_sampling_frequency > 2.5 * max_freq) ? 2.5 * max_freq : g_sampling_frequency;
-  Serial.printf("[FFT] Optimal sampling rate: %d Hz\n", freq);
+
+  // Keeps the rate without a peak, raises or lowers it otherwise, never below RATE_MIN
+  rate_controller_t rate_controller;
+  rate_controller_init(&rate_controller);
+  const rate_decision_t decision = rate_controller_update(&rate_controller, freq, max_freq);
+  freq = decision.rate;
+  Serial.printf("[FFT] Optimal sampling rate: %d Hz (%s)\n", freq, rate_reason_name(decision.reason));
 }
 
 
 void sampling_avg_task(void *args) {
-  float sample = 0.0;
-  float sampleReadings[] = {0}; // Sample buffer
-  float sum = 0;
-  window_size = WINDOW_SECONDS * freq;
+  sample_source_t src;
+  fft_sample_t sample = 0;
+  time_window_t window;
+  time_window_result_t result;
+  const uint32_t period_us = sample_period_us(freq);
+  int count = 0;
+  time_window_init(&window, TIME_WINDOW_TUMBLING, TIME_WINDOW_SIZE_MS, 0);
+  quantile_sketch_init(&sketch);
+
+  // Continue the signal where the previous duty cycle left it, light sleep paces the loop
+  sample_source_open_synthetic(&src, signal_low_freq, NULL, freq,
+                               sample_i + (freq*num_of_restarts*(appTxDutyCycle/1000)), false);
 
   Serial.print("[SAMPLING] Starting to sampling at frequency: ");
   Serial.println(freq);
   Serial.println("**********************");
-  for(int i=0;i < window_size;i++){
-    sample = sample_signal(signal_low_freq, i + sample_i + (freq*num_of_restarts*(appTxDutyCycle/1000)),freq);
+  // Sample until the window closes, its length is set by the clock and not by the rate
+  while (!time_window_advance(&window, sample_time_us, &result)) {
+    sample_source_read(&src, &sample, 1);
     Serial.print("[SAMPLING] Sample: ");
-    Serial.println(sample);
-    sampleReadings[i] = sample;
+    Serial.println(sample_to_float(sample));
+    time_window_add(&window, sample_to_float(sample), sample_time_us);
+    quantile_sketch_add(&sketch, sample_to_float(sample));
+    sample_time_us += period_us;
+    count++;
     uart_wait_tx_idle_polling((uart_port_t)CONFIG_ESP_CONSOLE_UART_NUM);
     esp_sleep_enable_timer_wakeup(1000*1000*1/freq);
     esp_light_sleep_start();
   }
-  sample_i += window_size;
-
-  for (int i = 0; i < window_size; i++) 
-    sum += sampleReadings[i];
-
-  avg = sum / window_size;
-  Serial.print("[AGGREGATE] Average calculated: ");
-  Serial.println(avg);
+  sample_source_close(&src);
+  sample_i += count;
+
+  record = result.record;
+  Serial.printf("[AGGREGATE] %lu samples, mean %.2f, min %.2f, max %.2f, var %.3f\n",
+                (unsigned long)record.count, record.mean, record.min, record.max, record.variance);
+  Serial.printf("[AGGREGATE] p50 %.2f, p90 %.2f, p99 %.2f\n", quantile_sketch_quantile(&sketch, 0.5f),
+                quantile_sketch_quantile(&sketch, 0.9f), quantile_sketch_quantile(&sketch, 0.99f));
   xTaskNotifyGive((TaskHandle_t)args);
   vTaskDelete(NULL);
 }
@@ -103,13 +124,39 @@ void sampling_avg_task(void *args) {
 /**
  * @brief Prepares LoRaWAN transmission frame
  * @param port Application port number
+ * @return false if not even the record fits the current data rate
  * @details
- * - Packages current average value
+ * - Packages the aggregate record of the last window, little-endian:
+ *   count, mean, min, max, variance, first and last sample time (µs)
+ * - Appends the quantile sketch of the window, compacted to what the current
+ *   data rate leaves after the record (at most LORA_SKETCH_BYTES). ADR may
+ *   lower the rate to DR0-2, where EU868 accepts 51 bytes instead of 115.
  * - Configures payload size
  */
-static void prepareTxFrame(uint8_t port){    
-    appDataSize = sizeof(float);
-    memcpy(appData, &avg, sizeof(float));
+static bool prepareTxFrame(uint8_t port){    
+    const void *fields[] = { &record.count, &record.mean, &record.min, &record.max,
+                             &record.variance, &record.first_us, &record.last_us };
+    const uint8_t record_bytes = sizeof(fields) / sizeof(fields[0]) * 4;
+
+    // Largest payload the MAC accepts now, pending MAC commands included
+    LoRaMacTxInfo_t txInfo;
+    LoRaMacQueryTxPossible(record_bytes, &txInfo);
+    appDataSize = 0;
+    if (txInfo.MaxPossiblePayload < record_bytes) {
+        Serial.printf("[LORA] Record of %u bytes does not fit the %u-byte payload of the data rate\n",
+                      record_bytes, txInfo.MaxPossiblePayload);
+        return false;
+    }
+    for (uint8_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) {
+        memcpy(appData + appDataSize, fields[f], 4);
+        appDataSize += 4;
+    }
+
+    // A sketch that cannot be compacted to the budget is left out
+    const uint8_t budget = txInfo.MaxPossiblePayload - record_bytes;
+    appDataSize += quantile_sketch_serialize(&sketch, appData + appDataSize,
+                                             budget < LORA_SKETCH_BYTES ? budget : LORA_SKETCH_BYTES);
+    return true;
 }
 
 /* System Initialization ---------------------------------------------------- */
@@ -129,7 +176,7 @@ void setup() {
   xTaskCreate(
     sampling_avg_task,          // Use the correct function name
     "SamplingAvgTask",          // Task name
-    2048,                       // Stack size
+    4096,                       // Stack size, Serial.printf with floats needs the room
     (void*)currentTaskHandle,   // Pass current task handle as parameter
     1,                          // Priority
     &sampling_avg_task_handler  // Store new task's handle in global variable
@@ -174,8 +221,9 @@ void loop() {
       case DEVICE_STATE_SEND:
       {
         vTaskDelay(pdMS_TO_TICKS(100));
-        prepareTxFrame(appPort);
-        LoRaWAN.send();
+        if (prepareTxFrame(appPort)) {
+          LoRaWAN.send();
+        }
         deviceState = DEVICE_STATE_CYCLE;
 
         break;
@@ -4,6 +4,7 @@
 #include "freertos/queue.h"
 #include "shared_defs.h"
 #include "config.h"
+#include "window_aggregate.h"
 
 
 // Global averages storage
@@ -36,40 +37,26 @@ void printAverages() {
  * @param pvParameters FreeRTOS task parameters (unused)
  * 
  * @implements
- * - Circular buffer for WINDOW_SIZE samples
- * - Moving average calculation
+ * - Sliding window of WINDOW_SIZE samples, O(1) AGGREGATE_WINDOW aggregate (window_aggregate.h)
  * - Results storage in avgs[] array
  * 
  */
 void average_task_handler(void *pvParameters) {
-  float sum = 0;
   float average = 0;
   float value;
-  
-  // Circular buffer implementation
-  float sampleReadings[WINDOW_SIZE] = {0};  // Storage for sliding window
+  AGGREGATE_WINDOW<float, WINDOW_SIZE> window;  // Sliding window
   int num_of_samples = 0;   // Total processed samples counter
-  int pos = 0;              // Current position in circular buffer
-  int valid_samples = 0;    // Count of initialized buffer elements
 
   while (1) {
     if (xQueueReceive(xQueueSamples, &(value), (TickType_t)portMAX_DELAY)) {
-      // Update circular buffer
-      sampleReadings[pos] = value;
-      pos = (pos + 1) % WINDOW_SIZE;
+      // Update the window and its moving aggregate
+      window.push(value);
+      average = window.value();
 
       Serial.printf("[AGGREGATE] Sample read: %.2f\n",value);
 
-      if (valid_samples < WINDOW_SIZE) valid_samples++; // Ensure we don't exceed the array size
-      // Calculate moving average
-      sum = 0;
-      for (int i = 0; i < valid_samples; i++) {
-          sum += sampleReadings[i];
-      }
-      average = sum / WINDOW_SIZE;
-
       // Store and log results
-      if(valid_samples == WINDOW_SIZE){
+      if(window.full()){
         avgs[num_of_samples] = average;
         Serial.printf("[AGGREGATE] Window %d: %.2f\n", num_of_samples, average);
         
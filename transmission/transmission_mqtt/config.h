@@ -1,5 +1,6 @@
 #pragma once
 #define WINDOW_SIZE 5
+#define AGGREGATE_WINDOW WindowMean // Moving aggregate: WindowMean, WindowMin, WindowMax, WindowVariance or Ewma
 
 #define WIFI_MAX_RETRIES 10
 #define MSG_BUFFER_SIZE 50
@@ -10,6 +11,7 @@
 
 #define INIT_SAMPLE_RATE 1000 // Hz
 #define NUM_SAMPLES 1024
+#define FFT_ANALYSIS_CORE 0 // Core left to Wi-Fi, MQTT and analysis, the sampling task is pinned to the other one
 #define QUEUE_SIZE NUM_OF_SAMPLES_AGGREGATE
 
 #define NUM_OF_SAMPLES_AGGREGATE 20
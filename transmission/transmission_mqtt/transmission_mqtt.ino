@@ -63,7 +63,7 @@ void startingTask(void *pvParameters) {
   Serial.println("[SYS] MQTT connected, starting sampling and aggregation tasks");
   
   // Only start sampling and aggregation tasks after WiFi is connected
-  xTaskCreate(fft_sampling_task, "Acquisition", TASK_STACK_SIZE, NULL, 2, NULL);
+  xTaskCreatePinnedToCore(fft_sampling_task, "Acquisition", TASK_STACK_SIZE, NULL, 2, NULL, !FFT_ANALYSIS_CORE);
   xTaskCreate(average_task_handler, "Averaging", TASK_STACK_SIZE, NULL, 1, NULL);
 
   vTaskDelete(NULL);
@@ -2,6 +2,7 @@ import paho.mqtt.client as mqtt
 import time
 import argparse
 import json
+import struct
 import warnings
 
 
@@ -20,6 +21,23 @@ TTN_TOPIC = "#"
 
 authenticated = False
 
+# Binary payload of the ESP32 (lib/payload.h), little-endian
+PAYLOAD_VERSION = 1
+PAYLOAD_HEADER = struct.Struct("<BBHI")    # version, record count, first id, send time (ms)
+PAYLOAD_RECORD = struct.Struct("<IffffII") # count, mean, min, max, variance, first and last sample (us)
+
+def decode_payload(payload):
+    """Header and records of a frame, None if it is not one"""
+    if len(payload) < PAYLOAD_HEADER.size:
+        return None
+    version, count, first_id, time_ms = PAYLOAD_HEADER.unpack_from(payload)
+    if version != PAYLOAD_VERSION or len(payload) != PAYLOAD_HEADER.size + count * PAYLOAD_RECORD.size:
+        return None
+    records = [dict(zip(("n", "mean", "min", "max", "var", "t0", "t1"),
+                        PAYLOAD_RECORD.unpack_from(payload, PAYLOAD_HEADER.size + i * PAYLOAD_RECORD.size)))
+               for i in range(count)]
+    return {"id": first_id, "time": time_ms, "records": records}
+
 def on_connect(client, userdata, flags, rc):
     print(f"Connected with result code {rc}")
     if(not authenticated):
@@ -32,11 +50,14 @@ def on_connect(client, userdata, flags, rc):
 def on_message(client, userdata, msg):
 
     if(not authenticated):
-        print(f"Received message on [{msg.topic}]: {msg.payload.decode()}")
-        # Send acknowledgment
-        ack_message = msg.payload.decode()
-        client.publish(ACK_TOPIC, ack_message)
-        print(f"Sent ACK to {ACK_TOPIC}: {ack_message}")
+        frame = decode_payload(msg.payload)
+        if frame is None:
+            print(f"Received {len(msg.payload)} bytes on [{msg.topic}], not a v{PAYLOAD_VERSION} frame: {msg.payload.hex()}")
+        else:
+            print(f"Received message on [{msg.topic}]: {frame}")
+        # Send acknowledgment, the frame echoed back unchanged for the RTT
+        client.publish(ACK_TOPIC, msg.payload)
+        print(f"Sent ACK to {ACK_TOPIC}: {len(msg.payload)} bytes")
     else:
         try:
             # Try to parse as JSON
@@ -0,0 +1,39 @@
+import argparse
+import struct
+import sys
+
+
+# Layout of sample_capture_header_t (lib/sample_source.h)
+CAPTURE_MAGIC = 0x50414353
+HEADER_FORMAT = "<IIII"
+
+def read_samples(path, column):
+    samples = []
+    with open(path) as f:
+        for line in f:
+            fields = line.replace(";", ",").split(",")
+            try:
+                samples.append(float(fields[column]))
+            except (ValueError, IndexError):
+                # Header or malformed line
+                continue
+    return samples
+
+def main():
+    parser = argparse.ArgumentParser(description="Convert a sensor trace to a sample capture for replay on the host")
+    parser.add_argument("input", help="Text or CSV file, one sample per line")
+    parser.add_argument("output", help="Capture file")
+    parser.add_argument("--rate", type=int, required=True, help="Sampling rate of the trace in Hz")
+    parser.add_argument("--column", type=int, default=0, help="CSV column holding the samples")
+    args = parser.parse_args()
+
+    samples = read_samples(args.input, args.column)
+    if not samples:
+        sys.exit("No samples found")
+    with open(args.output, "wb") as f:
+        f.write(struct.pack(HEADER_FORMAT, CAPTURE_MAGIC, args.rate, len(samples), 0))
+        f.write(struct.pack(f"<{len(samples)}f", *samples))
+    print(f"Wrote {len(samples)} samples at {args.rate} Hz to {args.output}")
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,160 @@
+/*
+ * Host check of the binary MQTT payload (lib/payload.h)
+ * Round-trips random batches, special floats and extreme counters through
+ * payload_encode()/payload_decode(), checks that truncated frames, wrong
+ * versions and short buffers are refused, then times the binary path
+ * against the JSON string the sketch used to publish.
+ *
+ * Build and run from the repository root:
+ *   g++ -std=gnu++11 -O2 -Ilib utils/payload_host.cpp lib/payload.cpp -o payload_host
+ *   ./payload_host          round trip and benchmark
+ *   ./payload_host --hex    one known frame in hex, to check a decoder against
+ */
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include "payload.h"
+
+#define ROUND_TRIPS 100000
+#define BENCH_ITERATIONS 1000000
+#define JSON_BUFFER_SIZE 192
+
+typedef std::chrono::steady_clock host_clock_t;
+
+/**
+ * @brief Mean time per iteration between two clock readings (ns)
+ */
+static double ns_per_iteration(host_clock_t::time_point from, host_clock_t::time_point to) {
+    return std::chrono::duration<double, std::nano>(to - from).count() / BENCH_ITERATIONS;
+}
+
+/**
+ * @brief Encode and decode random batches
+ * @return Number of failed checks
+ */
+static int payload_round_trip(void) {
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> value(-1e4f, 1e4f);
+    int failures = 0;
+
+    for (int t = 0; t < ROUND_TRIPS; t++) {
+        aggregate_record_t records[3];
+        const uint8_t count = 1 + rng() % 3;
+        for (uint8_t i = 0; i < count; i++) {
+            records[i].count = rng();
+            records[i].mean = value(rng);
+            records[i].min = (t % 7 == 0) ? -INFINITY : value(rng);
+            records[i].max = (t % 11 == 0) ? 3.4e38f : value(rng);
+            records[i].variance = (t % 13 == 0) ? 1e-38f : fabsf(value(rng));
+            records[i].first_us = rng();
+            records[i].last_us = 0xFFFFFFFFu - rng() % 5;
+        }
+
+        uint8_t buf[PAYLOAD_BYTES(3)];
+        const uint16_t first_id = rng();
+        const uint32_t time_ms = rng();
+        const uint16_t len = payload_encode(buf, sizeof(buf), first_id, time_ms, records, count);
+
+        payload_header_t header;
+        aggregate_record_t decoded[3];
+        if (len != PAYLOAD_BYTES(count) || !payload_decode(buf, len, &header, decoded, 3) ||
+            header.count != count || header.first_id != first_id || header.time_ms != time_ms ||
+            memcmp(decoded, records, count * sizeof(records[0])) != 0) {
+            failures++;
+        }
+        // Truncated frame and unknown version
+        if (payload_decode(buf, len - 1, &header, decoded, 3)) {
+            failures++;
+        }
+        buf[0] = PAYLOAD_VERSION + 1;
+        if (payload_decode(buf, len, &header, decoded, 3)) {
+            failures++;
+        }
+    }
+
+    // A buffer too small for one record
+    uint8_t small[PAYLOAD_BYTES(1) - 1];
+    const aggregate_record_t record = {};
+    if (payload_encode(small, sizeof(small), 0, 0, &record, 1) != 0) {
+        failures++;
+    }
+    return failures;
+}
+
+/**
+ * @brief Time the JSON string the sketch used to publish against the binary frame
+ */
+static void payload_benchmark(void) {
+    aggregate_record_t record = {512, 12.3456f, -3.21f, 45.6f, 7.891f, 123456789, 123956789};
+    char json[JSON_BUFFER_SIZE];
+    uint8_t buf[PAYLOAD_BYTES(1)];
+    volatile uint32_t sink = 0;
+    int json_len = 0;
+
+    const host_clock_t::time_point t0 = host_clock_t::now();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        record.mean += 1e-4f;
+        json_len = snprintf(json, sizeof(json),
+                            "{\"id\":%d,\"value\":%.2f,\"n\":%lu,\"min\":%.2f,\"max\":%.2f,\"var\":%.3f,"
+                            "\"t0\":%lu,\"t1\":%lu,\"time\":%lu}",
+                            i & 1023, record.mean, (unsigned long)record.count, record.min, record.max,
+                            record.variance, (unsigned long)record.first_us, (unsigned long)record.last_us,
+                            (unsigned long)i);
+        sink += json[5];
+    }
+    const host_clock_t::time_point t1 = host_clock_t::now();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        int id;
+        float mean, min, max, variance;
+        unsigned long count, first_us, last_us, time_ms;
+        sscanf(json,
+               "{\"id\":%d,\"value\":%f,\"n\":%lu,\"min\":%f,\"max\":%f,\"var\":%f,"
+               "\"t0\":%lu,\"t1\":%lu,\"time\":%lu}",
+               &id, &mean, &count, &min, &max, &variance, &first_us, &last_us, &time_ms);
+        sink += id;
+    }
+    const host_clock_t::time_point t2 = host_clock_t::now();
+    uint16_t len = 0;
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        record.mean += 1e-4f;
+        len = payload_encode(buf, sizeof(buf), i, i, &record, 1);
+        sink += buf[9];
+    }
+    const host_clock_t::time_point t3 = host_clock_t::now();
+    payload_header_t header;
+    aggregate_record_t decoded;
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        buf[2] = i;
+        payload_decode(buf, len, &header, &decoded, 1);
+        sink += header.first_id;
+    }
+    const host_clock_t::time_point t4 = host_clock_t::now();
+
+    printf("JSON   %3d B: encode %6.1f ns, decode (sscanf) %6.1f ns\n", json_len,
+           ns_per_iteration(t0, t1), ns_per_iteration(t1, t2));
+    printf("binary %3u B: encode %6.1f ns, decode %6.1f ns\n", len,
+           ns_per_iteration(t2, t3), ns_per_iteration(t3, t4));
+    printf("bytes per sample at %lu samples per record: JSON %.3f, binary %.3f, 16-record frame %.4f\n",
+           (unsigned long)record.count, json_len / (double)record.count, len / (double)record.count,
+           PAYLOAD_BYTES(16) / (16.0 * record.count));
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "--hex") == 0) {
+        const aggregate_record_t record = {512, 1.5f, -2.25f, 3.75f, 0.125f, 1000, 2000000};
+        uint8_t buf[PAYLOAD_BYTES(1)];
+        const uint16_t len = payload_encode(buf, sizeof(buf), 7, 123456, &record, 1);
+        for (uint16_t i = 0; i < len; i++) {
+            printf("%02x", buf[i]);
+        }
+        printf("\n");
+        return 0;
+    }
+
+    const int failures = payload_round_trip();
+    printf("round trip: %d failed checks over %d batches\n", failures, ROUND_TRIPS);
+    payload_benchmark();
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,99 @@
+/*
+ * Host run of the ping-pong block pipeline (lib/block_pipeline.h)
+ * Paces a synthetic tone at the sampling rate on absolute deadlines, pushes
+ * it through the same pipeline code as the device, with the worker on a
+ * pthread, and reports sample gaps, block latency and dropped blocks.
+ *
+ * Build and run from the repository root:
+ *   g++ -std=gnu++11 -O2 -Ilib utils/pipeline_host.cpp lib/block_pipeline.cpp -o pipeline_host -lpthread
+ *   ./pipeline_host [rate_hz] [seconds] [tone_hz] [extra_analysis_ms]
+ * extra_analysis_ms slows the worker down to show dropped blocks.
+ */
+#include <atomic>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "block_pipeline.h"
+#include "fft_plan.h"
+#include "noise_floor.h"
+
+#if FFT_FIXED_POINT
+#error "The host run uses the float FFT, build with FFT_FIXED_POINT 0"
+#endif
+
+typedef FftPlan<NUM_SAMPLES, FFT_WINDOW_TYPE> fft_plan_t;
+
+static fft_sample_t s_ping[NUM_SAMPLES];
+static fft_sample_t s_pong[NUM_SAMPLES];
+static std::atomic<float> s_last_peak_hz(-1);
+static long s_extra_analysis_ns = 0;
+
+/**
+ * @brief Analyse callback, same transform and peak search as the device
+ */
+static void analyse(fft_sample_t *data, int sampling_frequency) {
+    fft_plan_t::window(data);
+    fft_plan_t::forward(data);
+    fft_plan_t::magnitude(data);
+    const float noise_floor = spectrum_noise_floor(data, NUM_SAMPLES);
+    int max_bin = -1;
+    for (uint16_t i = 1; i < (NUM_SAMPLES >> 1); i++) {
+        if (data[i] > data[i - 1] && data[i] > data[i + 1] && data[i] > noise_floor) {
+            max_bin = i;
+        }
+    }
+    if (max_bin > 0) {
+        const float offset = fft_peak_offset(data[max_bin - 1], data[max_bin], data[max_bin + 1]);
+        s_last_peak_hz.store((max_bin + offset) * sampling_frequency / NUM_SAMPLES);
+    }
+    if (s_extra_analysis_ns > 0) {
+        struct timespec delay = {s_extra_analysis_ns / 1000000000L, s_extra_analysis_ns % 1000000000L};
+        nanosleep(&delay, NULL);
+    }
+}
+
+int main(int argc, char **argv) {
+    const int rate = argc > 1 ? atoi(argv[1]) : 1000;
+    const double seconds = argc > 2 ? atof(argv[2]) : 10;
+    const float tone = argc > 3 ? (float)atof(argv[3]) : 100;
+    s_extra_analysis_ns = argc > 4 ? (long)(atof(argv[4]) * 1e6) : 0;
+    if (rate <= 0 || seconds <= 0) {
+        fprintf(stderr, "usage: %s [rate_hz] [seconds] [tone_hz] [extra_analysis_ms]\n", argv[0]);
+        return 1;
+    }
+
+    if (!block_pipeline_start(s_ping, s_pong, analyse)) {
+        fprintf(stderr, "Could not start the pipeline worker\n");
+        return 1;
+    }
+
+    // Sampling loop on absolute deadlines, like the device timer
+    const long period_ns = 1000000000L / rate;
+    const long total = (long)(seconds * rate);
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    for (long i = 0; i < total; i++) {
+        next.tv_nsec += period_ns;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        block_pipeline_push(sample_from_float(4 * sinf(2 * (float)M_PI * tone * i / rate)), rate);
+    }
+
+    // Let the worker finish the last block it was handed
+    const long settle_ns = s_extra_analysis_ns + 100000000L;
+    struct timespec settle = {settle_ns / 1000000000L, settle_ns % 1000000000L};
+    nanosleep(&settle, NULL);
+
+    const block_pipeline_stats_t stats = block_pipeline_get_stats();
+    printf("%ld samples at %d Hz, %d-sample blocks\n", total, rate, NUM_SAMPLES);
+    printf("blocks analysed %u, dropped %u, restarted %u\n",
+           stats.blocks_analysed, stats.blocks_dropped, stats.blocks_restarted);
+    printf("max sample gap %u us (period %ld us)\n", stats.max_sample_gap_us, period_ns / 1000);
+    printf("block latency last %u us, max %u us\n", stats.last_latency_us, stats.max_latency_us);
+    printf("last peak %.2f Hz (tone %.2f Hz)\n", s_last_peak_hz.load(), tone);
+    return 0;
+}
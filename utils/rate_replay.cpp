@@ -0,0 +1,102 @@
+/*
+ * Host replay of the sampling rate controller (lib/rate_controller.h)
+ * Feeds the controller the max frequency of a signal whose regime changes
+ * over time and prints every decision. Like the FFT, the estimate only sees
+ * content below the Nyquist frequency of the current rate: anything above it
+ * folds back onto a lower bin, so the replay shows how the controller finds
+ * a regime it cannot see yet.
+ *
+ * Build and run from the repository root:
+ *   g++ -std=gnu++11 -O2 -Ilib utils/rate_replay.cpp lib/rate_controller.cpp -o rate_replay
+ *   ./rate_replay                      built-in regimes
+ *   ./rate_replay trace.csv            one "estimates,max_freq_hz" regime per line
+ */
+#include <math.h>
+#include <stdio.h>
+#include "rate_controller.h"
+
+#define REPLAY_MAX_REGIMES 64
+
+// A signal whose max frequency stays put for a number of estimates
+typedef struct {
+    int estimates;
+    float max_freq;  // Hz, <= 0 for no component
+} replay_regime_t;
+
+static const replay_regime_t DEFAULT_REGIMES[] = {
+    {6, 5},      // Slow signal, the rate settles low
+    {4, 300},    // Jump far above the current Nyquist frequency, folded at first
+    {6, 40},     // Back down, lowered in steps after the hold
+    {3, 0},      // Signal gone
+    {4, 42}      // Back, same regime as before
+};
+
+/**
+ * @brief What an FFT at a rate reports for a tone
+ * @param max_freq Actual max frequency (Hz)
+ * @param rate Sampling rate (Hz)
+ * @return Frequency folded into 0..rate/2
+ */
+static float replay_observed(float max_freq, int rate) {
+    if (max_freq <= 0) {
+        return -1;
+    }
+    const float folded = fmodf(max_freq, (float)rate);
+    return folded > rate / 2.0f ? rate - folded : folded;
+}
+
+/**
+ * @brief Read "estimates,max_freq_hz" lines
+ * @return Number of regimes read
+ */
+static int replay_load(const char *path, replay_regime_t *regimes, int max_regimes) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return 0;
+    }
+    int n = 0;
+    char line[128];
+    while (n < max_regimes && fgets(line, sizeof(line), f) != NULL) {
+        if (sscanf(line, "%d,%f", &regimes[n].estimates, &regimes[n].max_freq) == 2 &&
+            regimes[n].estimates > 0) {
+            n++;
+        }
+    }
+    fclose(f);
+    return n;
+}
+
+int main(int argc, char **argv) {
+    replay_regime_t regimes[REPLAY_MAX_REGIMES];
+    int num_regimes = sizeof(DEFAULT_REGIMES) / sizeof(DEFAULT_REGIMES[0]);
+    if (argc > 1) {
+        num_regimes = replay_load(argv[1], regimes, REPLAY_MAX_REGIMES);
+        if (num_regimes == 0) {
+            fprintf(stderr, "No regimes read from %s\n", argv[1]);
+            return 1;
+        }
+    } else {
+        for (int r = 0; r < num_regimes; r++) {
+            regimes[r] = DEFAULT_REGIMES[r];
+        }
+    }
+
+    rate_controller_t controller;
+    rate_controller_init(&controller);
+    int rate = INIT_SAMPLE_RATE;
+    int step = 0;
+    printf("step  actual Hz  seen Hz   rate Hz  action  reason\n");
+    for (int r = 0; r < num_regimes; r++) {
+        for (int e = 0; e < regimes[r].estimates; e++, step++) {
+            const float seen = replay_observed(regimes[r].max_freq, rate);
+            const rate_decision_t d = rate_controller_update(&controller, rate, seen);
+            printf("%4d  %9.2f  %7.2f  %5d -> %-5d  %-6s  %s\n", step, regimes[r].max_freq, seen,
+                   rate, d.rate, d.action == RATE_RAISE ? "raise" : d.action == RATE_LOWER ? "lower" : "hold",
+                   rate_reason_name(d.reason));
+            rate = d.rate;
+        }
+        const bool covered = regimes[r].max_freq <= 0 || rate >= 2 * regimes[r].max_freq;
+        printf("      regime %d ends at %d Hz%s\n", r, rate, covered ? "" : ", below its Nyquist rate");
+    }
+    return 0;
+}